@@ -0,0 +1,178 @@
+#pragma once
+
+// Bulk construction of an OpenVolumeMesh tet mesh from a tet soup (flat vertex and
+// tet index arrays), in time linear in the number of tets.
+//
+// Edges and faces are deduplicated with open-addressing tables keyed on the sorted
+// vertex pair / triple, so a face shared by two tets is found whatever order the
+// tets list its vertices in. Every entity is counted before the mesh is touched,
+// the mesh is reserved once, entities are added with bottom-up incidences switched
+// off, and the incidences are then built in a single pass over the whole mesh.
+//
+// Halffaces follow the convention of the original simple_mesh: the halfface used
+// by a cell has its normal (right-hand rule over its vertex order) pointing towards
+// the vertex opposite to it, as with TetrahedralMeshTopologyKernel::add_cell().
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <OpenVolumeMesh/Core/Handles.hh>
+
+namespace TetSoup {
+
+// sorted vertex tuples -> consecutive ids. A slot holds an id and the high bits
+// of its hash, so probing only reads the tuple itself on a likely match.
+template <int N>
+class TupleIndex {
+public:
+    typedef std::array<int, N> Tuple;
+    std::vector<Tuple> tuples;  // id -> sorted tuple, in insertion order
+
+    explicit TupleIndex(size_t expected) {
+        tuples.reserve(expected);
+        size_t capacity = 16;
+        while (capacity < 2 * expected) capacity *= 2;
+        slots_.assign(capacity, Slot{ 0, -1 });
+    }
+
+    // id of the sorted tuple t, adding it if it is new
+    int insert(const Tuple& t) {
+        if (2 * (tuples.size() + 1) > slots_.size()) grow();
+        const uint64_t h = hash(t);
+        const uint32_t tag = (uint32_t)(h >> 32);
+        size_t s = h & (slots_.size() - 1);
+        while (slots_[s].id >= 0) {
+            if (slots_[s].tag == tag && tuples[slots_[s].id] == t) return slots_[s].id;
+            s = (s + 1) & (slots_.size() - 1);
+        }
+        slots_[s] = Slot{ tag, (int)tuples.size() };
+        tuples.push_back(t);
+        return slots_[s].id;
+    }
+
+    size_t size() const { return tuples.size(); }
+
+private:
+    struct Slot {
+        uint32_t tag;
+        int id;
+    };
+    std::vector<Slot> slots_;
+
+    static uint64_t hash(const Tuple& t) {
+        uint64_t h = 0;
+        for (int k = 0; k < N; k++) h = (h ^ (uint32_t)t[k]) * 0x9E3779B97F4A7C15ull;
+        // murmur3 finalizer, so that the low bits used for the slot are well mixed
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    void grow() {
+        slots_.assign(slots_.size() * 2, Slot{ 0, -1 });
+        for (int id = 0; id < (int)tuples.size(); id++) {
+            const uint64_t h = hash(tuples[id]);
+            size_t s = h & (slots_.size() - 1);
+            while (slots_[s].id >= 0) s = (s + 1) & (slots_.size() - 1);
+            slots_[s] = Slot{ (uint32_t)(h >> 32), id };
+        }
+    }
+};
+
+// flat soup -> _mesh (cleared first). _points: xyz per vertex, _tets: 4 vertex
+// indices per tet. Vertex i and cell t of the mesh are vertex i and tet t of the
+// soup. Returns false on an out-of-range vertex index. _bottom_up_incidences can be
+// false when the mesh is only written out, which needs none of them.
+template <class MeshT, typename Scalar>
+bool build(MeshT& _mesh, const Scalar* _points, size_t _n_vertices, const int* _tets, size_t _n_tets,
+           bool _bottom_up_incidences = true) {
+    typedef typename MeshT::PointT PointT;
+    typedef typename PointT::value_type Real;
+    using namespace OpenVolumeMesh;
+
+    for (size_t i = 0; i < 4 * _n_tets; i++) {
+        if (_tets[i] < 0 || (size_t)_tets[i] >= _n_vertices) return false;
+    }
+
+    // tet faces as (vertex, vertex, vertex) with the normal pointing to the fourth
+    // vertex when the tet is positively oriented
+    static const int faceCorners[4][3] = { {0, 1, 2}, {0, 2, 3}, {0, 3, 1}, {1, 3, 2} };
+
+    // a closed tet mesh has about 2 faces and 1.2 edges per tet
+    TupleIndex<2> edges(_n_tets + _n_tets / 4 + 16);
+    TupleIndex<3> faces(2 * _n_tets + 16);
+    std::vector<int> cellFaces(4 * _n_tets);  // face id * 2 + halfface
+    std::vector<std::array<int, 3>> faceEdges;  // (s0, s1), (s1, s2), (s0, s2)
+    faceEdges.reserve(2 * _n_tets + 16);
+    for (size_t t = 0; t < _n_tets; t++) {
+        int v[4] = { _tets[4 * t], _tets[4 * t + 1], _tets[4 * t + 2], _tets[4 * t + 3] };
+        // orientation once per tet: a negative tet is made positive by swapping two
+        // vertices, which keeps every face normal pointing inwards
+        const Scalar* p0 = _points + 3 * v[0];
+        double d[3][3];
+        for (int k = 0; k < 3; k++) {
+            const Scalar* p = _points + 3 * v[k + 1];
+            for (int c = 0; c < 3; c++) d[k][c] = (double)p[c] - (double)p0[c];
+        }
+        const double det = d[0][0] * (d[1][1] * d[2][2] - d[1][2] * d[2][1])
+                         - d[0][1] * (d[1][0] * d[2][2] - d[1][2] * d[2][0])
+                         + d[0][2] * (d[1][0] * d[2][1] - d[1][1] * d[2][0]);
+        if (det <= 0) std::swap(v[1], v[2]);
+
+        for (int f = 0; f < 4; f++) {
+            const int a = v[faceCorners[f][0]], b = v[faceCorners[f][1]], c = v[faceCorners[f][2]];
+            // sort, counting swaps: an odd permutation of the sorted triple is the
+            // face's second halfface
+            std::array<int, 3> s = { a, b, c };
+            int parity = 0;
+            if (s[0] > s[1]) { std::swap(s[0], s[1]); parity ^= 1; }
+            if (s[1] > s[2]) { std::swap(s[1], s[2]); parity ^= 1; }
+            if (s[0] > s[1]) { std::swap(s[0], s[1]); parity ^= 1; }
+            const size_t n = faces.size();
+            const int fid = faces.insert(s);
+            if (faces.size() > n) {
+                faceEdges.push_back({ edges.insert({ s[0], s[1] }), edges.insert({ s[1], s[2] }), edges.insert({ s[0], s[2] }) });
+            }
+            cellFaces[4 * t + f] = 2 * fid + parity;
+        }
+    }
+
+    _mesh.clear();
+    _mesh.enable_bottom_up_incidences(false);
+    _mesh.reserve_vertices(_n_vertices);
+    _mesh.reserve_edges(edges.size());
+    _mesh.reserve_faces(faces.size());
+    _mesh.reserve_cells(_n_tets);
+
+    for (size_t i = 0; i < _n_vertices; i++) {
+        _mesh.add_vertex(PointT((Real)_points[3 * i], (Real)_points[3 * i + 1], (Real)_points[3 * i + 2]));
+    }
+    // edges are stored low -> high vertex, so their first halfedge ascends
+    for (const auto& e : edges.tuples) {
+        _mesh.add_edge(VertexHandle(e[0]), VertexHandle(e[1]), true);
+    }
+    // faces go around their sorted triple: s0 -> s1 -> s2 -> s0
+    std::vector<HalfEdgeHandle> halfedges(3);
+    for (const auto& e : faceEdges) {
+        halfedges[0] = _mesh.halfedge_handle(EdgeHandle(e[0]), 0);
+        halfedges[1] = _mesh.halfedge_handle(EdgeHandle(e[1]), 0);
+        halfedges[2] = _mesh.halfedge_handle(EdgeHandle(e[2]), 1);
+        _mesh.add_face(halfedges, false);
+    }
+    std::vector<HalfFaceHandle> halffaces(4);
+    for (size_t t = 0; t < _n_tets; t++) {
+        for (int f = 0; f < 4; f++) {
+            const int hf = cellFaces[4 * t + f];
+            halffaces[f] = _mesh.halfface_handle(FaceHandle(hf / 2), hf % 2);
+        }
+        _mesh.add_cell(halffaces, false);
+    }
+
+    if (_bottom_up_incidences) _mesh.enable_bottom_up_incidences(true);
+    return true;
+}
+
+} // namespace TetSoup
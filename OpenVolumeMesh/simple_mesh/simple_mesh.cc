@@ -1,9 +1,10 @@
 // C++ includes
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
-#include <vector>
 #include <string>
-#include <fstream>
-#include <unordered_map>
+#include <vector>
 
 // Include vector classes
 #include <OpenVolumeMesh/Geometry/VectorT.hh>
@@ -12,138 +13,101 @@
 #include <OpenVolumeMesh/Mesh/PolyhedralMesh.hh>
 
 #include <OpenVolumeMesh/FileManager/FileManager.hh>
+#include <OpenVolumeMesh/IO/ovmb_write.hh>
+
+#include "TetSoupBuilder.hh"
 
 // Make some typedefs to facilitate your life
 typedef OpenVolumeMesh::Geometry::Vec3f         Vec3f;
 typedef OpenVolumeMesh::GeometryKernel<Vec3f>   PolyhedralMeshV3f;
 
-// verts [NV,3]; simplicies [NC,4]
-void readVerts(std::string file_path, std::vector<std::vector<float>>& verts, std::vector<std::vector<int>>& cells) {
-  std::ifstream myfile (file_path);
-  if (myfile.is_open()) {
-    int Num;
-    myfile >> Num; // read verts
-    for (int idx = 0; idx < Num; idx++) {
-        float v1, v2, v3; myfile >> v1; myfile>> v2; myfile >> v3;
-        std::vector<float> cur = {v1, v2, v3};
-        verts.push_back(cur);
+// verts [NV,3]; simplicies [NC,4], flattened. The file is read in one go and parsed
+// with strtof/strtol, which is much faster than operator>> on multi-million-tet files.
+bool readVerts(const std::string& file_path, std::vector<float>& verts, std::vector<int>& cells) {
+    FILE* f = std::fopen(file_path.c_str(), "rb");
+    if (!f) {
+        std::cerr << "Unable to open file " << file_path << std::endl;
+        return false;
     }
-    myfile >> Num; // read cells
-    for (int idx = 0; idx < Num; idx++) {
-        int id1, id2, id3, id4; 
-        myfile >> id1; myfile >> id2; myfile >> id3; myfile >> id4;
-        std::vector<int> cur = {id1, id2, id3, id4};
-        cells.push_back(cur);
+    std::fseek(f, 0, SEEK_END);
+    const long size = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    std::string text(size, '\0');
+    const size_t n_read = std::fread(&text[0], 1, size, f);
+    std::fclose(f);
+    text.resize(n_read);
+
+    const char* p = text.c_str();
+    char* end;
+    const long n_verts = std::strtol(p, &end, 10); p = end; // read verts
+    if (n_verts < 0) return false;
+    verts.resize(3 * n_verts);
+    for (long idx = 0; idx < 3 * n_verts; idx++) {
+        verts[idx] = std::strtof(p, &end);
+        if (end == p) return false;
+        p = end;
     }
-        myfile.close();
+    const long n_cells = std::strtol(p, &end, 10); p = end; // read cells
+    if (n_cells < 0) return false;
+    cells.resize(4 * n_cells);
+    for (long idx = 0; idx < 4 * n_cells; idx++) {
+        cells[idx] = (int)std::strtol(p, &end, 10);
+        if (end == p) return false;
+        p = end;
     }
-
-  else std::cout << "Unable to open file \n"; 
+    return true;
 }
 
-int getHalfFaceID(std::vector<Vec3f>& vertsPerCell) {
-    // determine the face[v1/v2/v3] ID wrt. v4
-    Vec3f v01 = vertsPerCell[1] - vertsPerCell[0];
-    Vec3f v02 = vertsPerCell[2] - vertsPerCell[0];
-    Vec3f v03 = vertsPerCell[3] - vertsPerCell[0];
-
-    // for (Vec3f v : vertsPerCell) std::cout << v << ", ";
-    // std::cout << std::endl;
-
-    if (v01.cross(v02).dot(v03) > 0) return 0;
-    else return 1;
+static double msSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
 }
- 
-int main(int _argc, char** _argv) {
 
+int main(int _argc, char** _argv) {
 
+    if (_argc < 3) {
+        std::cout << "simple_mesh tetmesh.txt output.ovm|output.ovmb" << std::endl;
+        return 1;
+    }
     std::string input_file = _argv[1];
     std::string save_name = _argv[2];
-    std::vector<std::vector<float>> verts;
-    std::vector<std::vector<int>> cells;
-    readVerts(input_file, verts, cells);
-
-    // Create mesh object
-    PolyhedralMeshV3f myMesh;
 
-    // add verts
-    std::vector<OpenVolumeMesh::VertexHandle> vert_handles;
-    for (std::vector<float> cur : verts) {
-        OpenVolumeMesh::VertexHandle vh = myMesh.add_vertex(Vec3f(cur[0], cur[1], cur[2]));
-        vert_handles.push_back(vh);
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<float> verts;
+    std::vector<int> cells;
+    if (!readVerts(input_file, verts, cells)) {
+        std::cerr << "Error: could not parse " << input_file << std::endl;
+        return 1;
     }
+    std::cout << "read " << verts.size() / 3 << " verts, " << cells.size() / 4 << " cells in " << msSince(t0) << " ms" << std::endl;
 
-    // add faces
-    // to avoid duplicate faces, use hash to check
-    std::unordered_map<std::string, OpenVolumeMesh::FaceHandle> fh_hash;
-    std::vector<OpenVolumeMesh::FaceHandle> face_handles;
-    for (std::vector<int> cur_cell : cells) {
-        std::vector<OpenVolumeMesh::VertexHandle> cur_vh;
-        OpenVolumeMesh::FaceHandle fh;
-        std::vector<OpenVolumeMesh::HalfFaceHandle> halffaces;
-        std::vector<Vec3f> vertsPerCell;
-        std::string fh_str;
-
-        cur_vh.push_back(vert_handles[cur_cell[0]]); // 0 1 2
-        cur_vh.push_back(vert_handles[cur_cell[1]]);
-        cur_vh.push_back(vert_handles[cur_cell[2]]);
-        fh_str = std::to_string(cur_cell[0]) + ", " + std::to_string(cur_cell[1]) + ", " + std::to_string(cur_cell[2]);
-        if (fh_hash.count(fh_str)) fh = fh_hash[fh_str];
-        else {fh = myMesh.add_face(cur_vh); fh_hash[fh_str] = fh;}
-        for (OpenVolumeMesh::FaceVertexIter fv_it = myMesh.fv_iter(fh); fv_it.valid(); fv_it++) {
-            vertsPerCell.push_back(myMesh.vertex(*fv_it));
-        }
-        vertsPerCell.push_back(myMesh.vertex(vert_handles[cur_cell[3]]));
-        halffaces.push_back(myMesh.halfface_handle(fh, getHalfFaceID(vertsPerCell)));
-        
-        cur_vh.clear(); vertsPerCell.clear();
-        cur_vh.push_back(vert_handles[cur_cell[0]]); // 0 1 3
-        cur_vh.push_back(vert_handles[cur_cell[1]]);
-        cur_vh.push_back(vert_handles[cur_cell[3]]);
-        fh_str = std::to_string(cur_cell[0]) + ", " + std::to_string(cur_cell[1]) + ", " + std::to_string(cur_cell[3]);
-        if (fh_hash.count(fh_str)) fh = fh_hash[fh_str];
-        else {fh = myMesh.add_face(cur_vh); fh_hash[fh_str] = fh;}
-        for (OpenVolumeMesh::FaceVertexIter fv_it = myMesh.fv_iter(fh); fv_it.valid(); fv_it++) {
-            vertsPerCell.push_back(myMesh.vertex(*fv_it));
-        }
-        vertsPerCell.push_back(myMesh.vertex(vert_handles[cur_cell[2]]));
-        halffaces.push_back(myMesh.halfface_handle(fh, getHalfFaceID(vertsPerCell)));
-
-        cur_vh.clear(); vertsPerCell.clear();
-        cur_vh.push_back(vert_handles[cur_cell[0]]); // 0 2 3
-        cur_vh.push_back(vert_handles[cur_cell[2]]);
-        cur_vh.push_back(vert_handles[cur_cell[3]]);
-        fh_str = std::to_string(cur_cell[0]) + ", " + std::to_string(cur_cell[2]) + ", " + std::to_string(cur_cell[3]);
-        if (fh_hash.count(fh_str)) fh = fh_hash[fh_str];
-        else {fh = myMesh.add_face(cur_vh); fh_hash[fh_str] = fh;}
-        for (OpenVolumeMesh::FaceVertexIter fv_it = myMesh.fv_iter(fh); fv_it.valid(); fv_it++) {
-            vertsPerCell.push_back(myMesh.vertex(*fv_it));
-        }
-        vertsPerCell.push_back(myMesh.vertex(vert_handles[cur_cell[1]]));
-        halffaces.push_back(myMesh.halfface_handle(fh, getHalfFaceID(vertsPerCell)));
-
-        cur_vh.clear(); vertsPerCell.clear();
-        cur_vh.push_back(vert_handles[cur_cell[1]]); // 1 2 3
-        cur_vh.push_back(vert_handles[cur_cell[2]]);
-        cur_vh.push_back(vert_handles[cur_cell[3]]);
-        fh_str = std::to_string(cur_cell[1]) + ", " + std::to_string(cur_cell[2]) + ", " + std::to_string(cur_cell[3]);
-        if (fh_hash.count(fh_str)) fh = fh_hash[fh_str];
-        else {fh = myMesh.add_face(cur_vh); fh_hash[fh_str] = fh;}
-        for (OpenVolumeMesh::FaceVertexIter fv_it = myMesh.fv_iter(fh); fv_it.valid(); fv_it++) {
-            vertsPerCell.push_back(myMesh.vertex(*fv_it));
-        }
-        vertsPerCell.push_back(myMesh.vertex(vert_handles[cur_cell[0]]));
-        halffaces.push_back(myMesh.halfface_handle(fh, getHalfFaceID(vertsPerCell)));
-
-        myMesh.add_cell(halffaces);
+    // Create mesh object
+    t0 = std::chrono::steady_clock::now();
+    PolyhedralMeshV3f myMesh;
+    const bool binary = save_name.size() > 5 && save_name.compare(save_name.size() - 5, 5, ".ovmb") == 0;
+    if (!TetSoup::build(myMesh, verts.data(), verts.size() / 3, cells.data(), cells.size() / 4, !binary)) {
+        std::cerr << "Error: " << input_file << " has a cell with an invalid vertex index" << std::endl;
+        return 1;
     }
+    std::cout << "built " << myMesh.n_edges() << " edges, " << myMesh.n_faces() << " faces in " << msSince(t0) << " ms" << std::endl;
 
     // Create file manager object
     OpenVolumeMesh::IO::FileManager fileManager;
     // Store mesh to file "myMesh.ovm" in the current directory
     // std::string save_name = "myMesh_debug.ovm";
-    fileManager.writeFile(save_name.c_str(), myMesh);
-    std::cout << "save mesh to " << save_name << std::endl;
+    t0 = std::chrono::steady_clock::now();
+    if (binary) {
+        OpenVolumeMesh::IO::WriteOptions options;
+        options.topology_type = OpenVolumeMesh::IO::WriteOptions::TopologyType::Tetrahedral;
+        if (OpenVolumeMesh::IO::ovmb_write(save_name.c_str(), myMesh, options) != OpenVolumeMesh::IO::WriteResult::Ok) {
+            std::cerr << "Error: could not write " << save_name << std::endl;
+            return 1;
+        }
+    }
+    else if (!fileManager.writeFile(save_name.c_str(), myMesh)) {
+        std::cerr << "Error: could not write " << save_name << std::endl;
+        return 1;
+    }
+    std::cout << "save mesh to " << save_name << " in " << msSince(t0) << " ms" << std::endl;
 
     return 0;
 }
@@ -17,6 +17,9 @@
 #include <tetwild/DisableWarnings.h>
 #include <CLI/CLI.hpp>
 #include <tetwild/EnableWarnings.h>
+#ifdef TETWILD_WITH_OVMB
+#include "ovmb_export.h"
+#endif
 
 using namespace tetwild;
 
@@ -109,11 +112,13 @@ int main(int argc, char *argv[]) {
     std::string output_volume;
     std::string output_surface;
     std::string slz_file;
+    std::string output_ovmb;
     Args args;
 
     CLI::App app{"RobustTetMeshing"};
     app.add_option("input,--input", input_surface, "Input surface mesh INPUT in .off/.obj/.stl/.ply format. (string, required)")->required();
     app.add_option("output,--output", output_volume, "Output tetmesh OUTPUT in .msh or .mesh format. (string, optional, default: input_file+postfix+'.msh')");
+    app.add_option("--ovmb", output_ovmb, "Also write the tetmesh to OVMB in OpenVolumeMesh binary .ovmb format, readable by volumeARAP. (string, optional)");
     app.add_option("--postfix", args.postfix, "Postfix P for output files. (string, optional, default: '_')");
     auto absolute = app.add_option("-a,--ideal-absolute-edge-length", args.initial_edge_len_abs, "Absolute edge length (not scaled by bbox). -a and -l cannot both be given as arguments.");
     auto relative = app.add_option("-l,--ideal-edge-length", args.initial_edge_len_rel, "ideal_edge_length = diag_of_bbox * L. (double, optional, default: 0.05)");
@@ -143,6 +148,14 @@ int main(int argc, char *argv[]) {
     spdlog::set_level(static_cast<spdlog::level::level_enum>(log_level));
     spdlog::flush_every(std::chrono::seconds(3));
 
+#ifndef TETWILD_WITH_OVMB
+    if (!output_ovmb.empty()) {
+        logger().error("TetWild was built without OpenVolumeMesh, cannot write {}", output_ovmb);
+        spdlog::shutdown();
+        return 1;
+    }
+#endif
+
     //initialization
     GEO::initialize();
     if(slz_file != "") {
@@ -188,6 +201,17 @@ int main(int argc, char *argv[]) {
         tetwild::tetrahedralization(VI, FI, VO, TO, AO, args);
     }
     saveFinalTetmesh(output_volume, output_surface, VO, TO, AO);
+#ifdef TETWILD_WITH_OVMB
+    if (!output_ovmb.empty()) {
+        logger().debug("Writing mesh to {}...", output_ovmb);
+        Eigen::MatrixXd VV = VO.transpose();
+        Eigen::MatrixXi TT = TO.transpose();
+        if (!saveOVMB(output_ovmb, VV.data(), VO.rows(), TT.data(), TO.rows())) {
+            spdlog::shutdown();
+            return 1;
+        }
+    }
+#endif
 
     spdlog::shutdown();
 
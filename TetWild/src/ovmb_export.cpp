@@ -0,0 +1,33 @@
+// This file is part of TetWild, a software for generating tetrahedral meshes.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "ovmb_export.h"
+
+#include <OpenVolumeMesh/Mesh/PolyhedralMesh.hh>
+#include <OpenVolumeMesh/IO/ovmb_write.hh>
+#include <iostream>
+
+#include "TetSoupBuilder.hh"
+
+bool saveOVMB(const std::string &filename, const double *V, size_t n_vertices, const int *T, size_t n_tets)
+{
+    using namespace OpenVolumeMesh;
+    GeometricPolyhedralMeshV3d mesh;
+    // the writer only walks the top-down topology
+    if (!TetSoup::build(mesh, V, n_vertices, T, n_tets, false)) {
+        std::cerr << "Error: tetmesh has an invalid vertex index" << std::endl;
+        return false;
+    }
+    // handles are stored with the smallest int encoding that fits their count
+    IO::WriteOptions options;
+    options.topology_type = IO::WriteOptions::TopologyType::Tetrahedral;
+    IO::WriteResult result = IO::ovmb_write(filename.c_str(), mesh, options);
+    if (result != IO::WriteResult::Ok) {
+        std::cerr << "Error: could not write " << filename << ": " << IO::to_string(result) << std::endl;
+        return false;
+    }
+    return true;
+}
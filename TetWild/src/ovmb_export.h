@@ -0,0 +1,16 @@
+// This file is part of TetWild, a software for generating tetrahedral meshes.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Write a tet soup as an OpenVolumeMesh binary file (.ovmb, topology type
+// tetrahedral), so that volumeARAP can load TetWild's output directly.
+// V: xyz per vertex, T: 4 vertex indices per tet. Built only with OpenVolumeMesh
+// (TETWILD_WITH_OVMB); kept free of OpenVolumeMesh headers, which need C++17.
+bool saveOVMB(const std::string &filename, const double *V, size_t n_vertices, const int *T, size_t n_tets);
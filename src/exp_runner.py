@@ -590,7 +590,8 @@ class Runner:
 
 
     def render_circle_image(self, recon_file=None, deform_file=None, use_deform=False, obj_path=None,
-                            fix_camera=False, is_view_dependent=False, save_dir="", is_val=False, add_alpha=False):
+                            fix_camera=False, is_view_dependent=False, save_dir="", is_val=False, add_alpha=False,
+                            native_deform=False):
         """
         Render images in a circular path and create a video.
 
@@ -604,6 +605,7 @@ class Runner:
             save_dir: directory to save the rendered images and video
             is_val: whether it's a validation rendering
             add_alpha: whether to add alpha channel to the rendered images
+            native_deform: whether to query the deformation through volumeARAP_batch's arapfield library
 
         Returns:
             None
@@ -621,7 +623,10 @@ class Runner:
             save_dir = os.path.join(self.base_exp_dir, save_dir)
 
         # Generate the convex hull and deltas for deformations if required
-        if use_deform:
+        if use_deform and native_deform:
+            from utils import genInverseDeformationNative, queryDeltaNative as queryDelta
+            hull, deltas = genInverseDeformationNative(recon_file, deform_file, fix_camera)
+        elif use_deform:
             from utils import genConvexhullVolume, queryDelta
             hull, deltas = genConvexhullVolume(recon_file, deform_file, fix_camera)
         else:
@@ -720,6 +725,9 @@ if __name__ == '__main__':
     parser.add_argument("--obj_path", type=str, default=None, 
                         help='mesh path')
 
+    parser.add_argument("--native_deform", action='store_true', 
+                        help='query the deformation with the arapfield library of volumeARAP_batch')
+
     # for cage extraction
     parser.add_argument("--do_dilation", action='store_true', 
     help='Optional. Extract cage from current NeRF')
@@ -773,4 +781,4 @@ if __name__ == '__main__':
         runner.batch_size = 300
         runner.render_circle_image(args.reconstructed_mesh_file, args.deformed_mesh_file,
                                 args.use_deform, args.obj_path, args.fix_camera, args.is_view_dependent,
-                                args.savedir, add_alpha=args.add_alpha)
+                                args.savedir, add_alpha=args.add_alpha, native_deform=args.native_deform)
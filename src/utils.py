@@ -78,6 +78,23 @@ def readVertsofOVM(ovm_path:str):
     return jt.array(verts, dtype=jt.float32)
 
 
+def readVertsofARAPFrames(frames_path:str, frame_id:int, topology_path:str = None):
+    '''
+        frames_path: arap_frames.bin written by volumeARAP --output positions|deltas
+        topology_path: arap_topology.ovm next to it, needed for deltas
+    '''
+    # header: magic[8], version, format (1 positions, 2 deltas), n_vertices, n_frames, frames_offset
+    header = np.fromfile(frames_path, dtype=np.uint32, count=4)
+    sizes = np.fromfile(frames_path, dtype=np.uint64, count=3, offset=16)
+    NumV, NumF, offset = int(sizes[0]), int(sizes[1]), int(sizes[2])
+    assert frame_id < NumF
+    verts = np.fromfile(frames_path, dtype=np.float32, count=NumV*3, offset=offset + frame_id*NumV*12).reshape(NumV, 3)
+    verts = jt.array(verts, dtype=jt.float32)
+    if header[3] == 2:
+        verts = verts + readVertsofOVM(topology_path)
+    return verts
+
+
 class jt_KNN(jt.nn.Module):
     def __init__(self, k):
         self.k = k
@@ -489,3 +506,88 @@ def queryDelta(hull, deltas, query_pts):
 
     return result, (tri_verts,tri_deltas,zero_mask)
 
+
+
+class NativeInverseDeformation():
+    """
+    Deformed space -> rest space through volumeARAP_batch's arapfield library
+    (InverseDeformation): a BVH over the deformed tets, refitted when the frame
+    changes. Set ARAP_FIELD_LIB to the library if it is not in volumeARAP_batch/build.
+    """
+
+    def __init__(self, reconstructed_mesh_file:str, deformed_mesh_file:str, lib_path:str = None) -> None:
+        import ctypes
+        if lib_path is None:
+            lib_path = os.environ.get('ARAP_FIELD_LIB', os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                                     '../volumeARAP_batch/build/libarapfield.so'))
+        lib = ctypes.CDLL(lib_path)
+        lib.arap_inverse_load.restype = ctypes.c_void_p
+        lib.arap_inverse_load.argtypes = [ctypes.c_char_p, ctypes.c_char_p]
+        lib.arap_inverse_load_deformed.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        lib.arap_inverse_query.restype = ctypes.c_size_t
+        lib.arap_inverse_query.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p, ctypes.c_void_p]
+        lib.arap_inverse_destroy.argtypes = [ctypes.c_void_p]
+        self.lib = lib
+        self.handle = lib.arap_inverse_load(reconstructed_mesh_file.encode(), deformed_mesh_file.encode())
+        assert self.handle, "could not load %s and %s" % (reconstructed_mesh_file, deformed_mesh_file)
+        self.frame = deformed_mesh_file
+
+    def set_frame(self, deformed_mesh_file:str) -> None:
+        if deformed_mesh_file != self.frame:
+            assert self.lib.arap_inverse_load_deformed(self.handle, deformed_mesh_file.encode()), deformed_mesh_file
+            self.frame = deformed_mesh_file
+
+    def query(self, pts) -> tuple:
+        """pts: [N,3] numpy -> rest positions [N,3] float32, inside [N] bool"""
+        pts = np.ascontiguousarray(pts, dtype=np.float32)
+        rest = np.empty_like(pts)
+        inside = np.empty(len(pts), dtype=np.uint8)
+        self.lib.arap_inverse_query(self.handle, pts.ctypes.data, len(pts), rest.ctypes.data, inside.ctypes.data)
+        return rest, inside.astype(bool)
+
+    def __deepcopy__(self, memo):
+        # the native tree is shared, not copied
+        return self
+
+    def __del__(self):
+        if getattr(self, 'handle', None):
+            self.lib.arap_inverse_destroy(self.handle)
+
+
+class NativeInverseFrame():
+    """one frame of a sequence, on a NativeInverseDeformation shared by all of them"""
+
+    def __init__(self, engine:NativeInverseDeformation, deformed_mesh_file:str) -> None:
+        self.engine, self.deformed_mesh_file = engine, deformed_mesh_file
+
+    def query(self, pts) -> tuple:
+        self.engine.set_frame(self.deformed_mesh_file)
+        return self.engine.query(pts)
+
+
+def genInverseDeformationNative(reconstructed_mesh_file:str, deformed_mesh_file:str, fix_camera = False) -> tuple:
+    """genConvexhullVolume() for queryDeltaNative(): the deltas live in the library, so they are None"""
+    if fix_camera:
+        import glob
+        deformed_mesh_files = sorted(glob.glob(os.path.join(deformed_mesh_file, '*.ovm')))
+        engine = NativeInverseDeformation(reconstructed_mesh_file, deformed_mesh_files[0])
+        print("finish constructing native inverse deformation !")
+        return [NativeInverseFrame(engine, x) for x in deformed_mesh_files], [None] * len(deformed_mesh_files)
+    else:
+        engine = NativeInverseDeformation(reconstructed_mesh_file, deformed_mesh_file)
+        print("finish constructing native inverse deformation !")
+        return engine, None
+
+def queryDeltaNative(hull, deltas, query_pts):
+    '''
+        queryDelta() on the native library
+        hull: NativeInverseDeformation or NativeInverseFrame
+        deltas: unused
+        query_pts: [bs, N, 3]
+    '''
+    bs, N, _ = query_pts.shape
+    pts = query_pts.reshape(-1,3).numpy()
+    rest, inside = hull.query(pts)
+    result = jt.array(rest - pts).reshape(bs, N, 3)
+    zero_mask = jt.array(~inside).reshape(bs, N, 1)
+    return result, (None, None, zero_mask)
@@ -0,0 +1,66 @@
+// Iterations-to-tolerance of plain local/global ARAP against Anderson-accelerated
+// ARAP. Every frame of the handle file is solved from the rest pose, so the whole
+// handle displacement has to be recovered within one frame.
+//
+// anderson_benchmark mesh.ovm handleFile hardConstrain [tol [maxIter [window...]]]
+// window 0 is the plain iteration; default windows: 0 3 5 10
+#include "ARAPDeform.h"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		std::cout << "anderson_benchmark mesh.ovm handleFile hardConstrain [tol [maxIter [window...]]]" << std::endl;
+		return 1;
+	}
+	TetrahedralMesh mesh;
+	if (!myReadFile(argv[1], mesh)) return 1;
+	bool hardConstrain = atoi(argv[3]);
+	double tol = argc > 4 ? atof(argv[4]) : 1e-5;
+	int maxIter = argc > 5 ? atoi(argv[5]) : 200;
+	std::vector<int> windows;
+	for (int i = 6; i < argc; i++) windows.push_back(atoi(argv[i]));
+	if (windows.empty()) windows = { 0, 3, 5, 10 };
+
+	ARAPDeform arap(mesh, hardConstrain);
+	std::ifstream iff(argv[2]);
+	arap.loadConstPoint(iff);
+	if (!arap.prefactor()) return 1;
+	arap.tolerance = tol;
+	arap.maxIterTime = maxIter;
+	arap.warmStart = false;
+
+	// the solver logs every iteration on std::cout
+	std::ostringstream sink;
+	std::streambuf* coutBuf = std::cout.rdbuf(sink.rdbuf());
+
+	printf("%d vertices, %d frames, tol %g, maxIter %d\n", (int)mesh.n_vertices(), (int)arap.seq_constPoint.size(), tol, maxIter);
+	printf("%8s %10s %10s %10s %10s %12s %14s\n", "window", "iters", "max iters", "converged", "rejected", "ms/frame", "final energy");
+	ARAPState state;
+	for (int window : windows)
+	{
+		arap.andersonWindow = window;
+		int iterations = 0, maxIterations = 0, converged = 0, rejected = 0;
+		double energy = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for (int seq_id = 0; seq_id < arap.seq_constPoint.size(); seq_id++)
+		{
+			ARAPFrameReport report = arap.deform_frame(arap.seq_constPoint[seq_id], state);
+			iterations += report.iterations;
+			maxIterations = std::max(maxIterations, report.iterations);
+			converged += report.converged;
+			rejected += report.rejected;
+			energy += arap.energy(state.Rots, state.positions, arap.seq_constPoint[seq_id]);
+			sink.str("");
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		int frames = std::max((int)arap.seq_constPoint.size(), 1);
+		printf("%8d %10.1f %10d %7d/%-3d %10d %12.2f %14.6e\n", window, (double)iterations / frames, maxIterations,
+			converged, frames, rejected, ms / frames, energy / frames);
+	}
+	std::cout.rdbuf(coutBuf);
+	return 0;
+}
@@ -0,0 +1,152 @@
+// Control edits against a fresh factorization. The last --edit k controls of each
+// handle file are left out of the first prefactor() and added one at a time through
+// ARAPDeform::add_control (low-rank terms next to the kept factor), then the first k
+// controls are taken out again through remove_control. After each phase the handle
+// sequence is solved (warm-started, a fixed number of iterations per frame) next to
+// an ARAPDeform prefactored from scratch with the same controls; the deviation column
+// is the largest vertex distance between the two over all frames, the edit column the
+// time of the k edits against one fresh prefactor().
+//
+// control_edit_benchmark [--edit k] [--iters n] [--hard] mesh1.ovm handleFile1 [mesh2.ovm handleFile2 ...]
+#include "ARAPDeform.h"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+static double msSince(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// controls [first, last) of every frame
+static std::vector<std::vector<Eigen::Vector3d>> sliceFrames(const std::vector<std::vector<Eigen::Vector3d>>& frames, int first, int last)
+{
+	std::vector<std::vector<Eigen::Vector3d>> sliced;
+	for (const std::vector<Eigen::Vector3d>& frame : frames) sliced.emplace_back(frame.begin() + first, frame.begin() + last);
+	return sliced;
+}
+
+// largest vertex distance between edited and fresh over the sequence; false if fresh cannot be factored
+static bool compareSequence(ARAPDeform& edited, ARAPDeform& fresh, const std::vector<std::vector<Eigen::Vector3d>>& frames,
+	double& freshMs, double& deviation)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	if (!fresh.prefactor()) return false;
+	freshMs = msSince(t0);
+	ARAPState editedState, freshState;
+	edited.init_state(editedState);
+	fresh.init_state(freshState);
+	deviation = 0;
+	for (const std::vector<Eigen::Vector3d>& frame : frames)
+	{
+		edited.deform_frame(frame, editedState);
+		fresh.deform_frame(frame, freshState);
+		for (int i = 0; i < (int)freshState.positions.size(); i++)
+		{
+			deviation = std::max(deviation, (editedState.positions[i] - freshState.positions[i]).norm());
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	int edits = 8;
+	int iters = 10;
+	bool hardConstrain = false;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--edit" && i + 1 < argc) edits = atoi(argv[++i]);
+		else if (arg == "--iters" && i + 1 < argc) iters = atoi(argv[++i]);
+		else if (arg == "--hard") hardConstrain = true;
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty() || inputs.size() % 2 != 0 || edits < 1)
+	{
+		std::cout << "control_edit_benchmark [--edit k] [--iters n] [--hard] mesh1.ovm handleFile1 [mesh2.ovm handleFile2 ...]" << std::endl;
+		return 1;
+	}
+
+	// the solver logs every iteration on std::cout
+	std::ostringstream sink;
+	std::streambuf* coutBuf = std::cout.rdbuf(sink.rdbuf());
+
+	int failed = 0;
+	for (int m = 0; m + 1 < (int)inputs.size(); m += 2)
+	{
+		TetrahedralMesh mesh;
+		if (!myReadFile(inputs[m].c_str(), mesh)) continue;
+		ARAPDeform base(mesh, hardConstrain);
+		std::ifstream iff(inputs[m + 1]);
+		base.loadConstPoint(iff);
+		const int n_controls = (int)base.bary_vert_index.size();
+		const int k = std::min(edits, n_controls - 1);
+		sink.str("");
+		if (k < 1)
+		{
+			std::cout.rdbuf(coutBuf);
+			printf("%s: needs at least two controls\n", inputs[m + 1].c_str());
+			std::cout.rdbuf(sink.rdbuf());
+			failed++;
+			continue;
+		}
+		const std::vector<Eigen::Vector4i>& tets = base.bary_vert_index;
+		const std::vector<Eigen::Vector4d>& barys = base.barycentric;
+
+		ARAPDeform edited(mesh, base.adjacency, hardConstrain);
+		edited.maxIterTime = iters;
+		edited.tolerance = 0;  // always run the full iteration count
+		edited.set_controls(std::vector<Eigen::Vector4i>(tets.begin(), tets.end() - k), std::vector<Eigen::Vector4d>(barys.begin(), barys.end() - k));
+		auto t0 = std::chrono::steady_clock::now();
+		if (!edited.prefactor())
+		{
+			failed++;
+			continue;
+		}
+		const double firstMs = msSince(t0);
+
+		std::cout.rdbuf(coutBuf);
+		printf("%s: %d vertices, %d controls, %d frames, %d iterations/frame, first factorization %.2f ms\n", inputs[m].c_str(),
+			(int)mesh.n_vertices(), n_controls, (int)base.seq_constPoint.size(), iters, firstMs);
+		printf("%10s %10s %10s %12s %12s %14s\n", "phase", "controls", "low-rank", "edit ms", "fresh ms", "deviation");
+		std::cout.rdbuf(sink.rdbuf());
+		for (int phase = 0; phase < 2; phase++)
+		{
+			// add the last k controls, or remove the first k
+			t0 = std::chrono::steady_clock::now();
+			bool ok = true;
+			for (int j = 0; j < k && ok; j++)
+			{
+				ok = phase == 0 ? edited.add_control(tets[n_controls - k + j], barys[n_controls - k + j]) >= 0 : edited.remove_control(0);
+			}
+			const double editMs = msSince(t0);
+			const int first = phase == 0 ? 0 : k;
+			ARAPDeform fresh(mesh, base.adjacency, hardConstrain);
+			fresh.maxIterTime = iters;
+			fresh.tolerance = 0;
+			fresh.set_controls(std::vector<Eigen::Vector4i>(tets.begin() + first, tets.end()), std::vector<Eigen::Vector4d>(barys.begin() + first, barys.end()));
+			double freshMs = 0, deviation = 0;
+			ok = ok && compareSequence(edited, fresh, sliceFrames(base.seq_constPoint, first, n_controls), freshMs, deviation);
+			sink.str("");
+			std::cout.rdbuf(coutBuf);
+			if (ok)
+			{
+				printf("%10s %10d %10d %12.2f %12.2f %14.3e\n", phase == 0 ? "add" : "remove", (int)edited.bary_vert_index.size(),
+					edited.solver.lowRankTerms(), editMs, freshMs, deviation);
+			}
+			else
+			{
+				printf("%10s %10s\n", phase == 0 ? "add" : "remove", "failed");
+				failed++;
+			}
+			std::cout.rdbuf(sink.rdbuf());
+		}
+		std::cout.rdbuf(coutBuf);
+		printf("\n");
+		std::cout.rdbuf(sink.rdbuf());
+	}
+	std::cout.rdbuf(coutBuf);
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Throughput of DeformationField queries on ray samples, the way the renderer asks
+// for them: rays from random points around the mesh's bounding box towards random
+// points inside it, sampled evenly over the part of the ray crossing the box, all
+// samples of a ray consecutive. The batch is queried with and without the last-hit
+// cache, in ray order and with the same samples shuffled (no coherence left). The
+// results of every run are checked against TetLocator::locate on a subset.
+// Without a deformed mesh the rest mesh is twisted about z.
+//
+// field_benchmark [--rays n] [--samples n] [--reps n] restMesh [deformedMesh]
+#include "DeformationField.h"
+#include "MyUtils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+static double msSince(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char *argv[])
+{
+	int rays = 20000, samples = 128, reps = 3;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--rays" && i + 1 < argc) rays = atoi(argv[++i]);
+		else if (arg == "--samples" && i + 1 < argc) samples = atoi(argv[++i]);
+		else if (arg == "--reps" && i + 1 < argc) reps = atoi(argv[++i]);
+		else files.push_back(arg);
+	}
+	if (files.empty())
+	{
+		std::cout << "field_benchmark [--rays n] [--samples n] [--reps n] restMesh [deformedMesh]" << std::endl;
+		return 1;
+	}
+	std::vector<Eigen::Vector3d> rest, deformed;
+	std::vector<Eigen::Vector4i> tets;
+	if (!readTetMesh(files[0], rest, tets)) return 1;
+	Eigen::AlignedBox3d box;
+	for (const Eigen::Vector3d& v : rest) box.extend(v);
+	if (files.size() > 1)
+	{
+		std::vector<Eigen::Vector4i> deformedTets;
+		if (!readTetMesh(files[1], deformed, deformedTets)) return 1;
+	}
+	else
+	{
+		deformed = rest;
+		const double height = std::max(box.sizes().z(), 1e-300);
+		for (Eigen::Vector3d& v : deformed) v = Eigen::AngleAxisd(0.5 * M_PI * (v.z() - box.min().z()) / height, Eigen::Vector3d::UnitZ()) * v;
+	}
+
+	DeformationField field;
+	auto t0 = std::chrono::steady_clock::now();
+	if (!field.build(rest, tets) || !field.set_deformed(deformed)) return 1;
+	const double buildMs = msSince(t0);
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	auto inBox = [&](const Eigen::AlignedBox3d& b) {
+		return Eigen::Vector3d(b.min() + b.sizes().cwiseProduct(Eigen::Vector3d(uniform(rng), uniform(rng), uniform(rng))));
+	};
+	Eigen::AlignedBox3d outer(box.center() - box.sizes(), box.center() + box.sizes());
+	const size_t n = (size_t)rays * samples;
+	std::vector<float> points(3 * n);
+	for (int r = 0; r < rays; r++)
+	{
+		const Eigen::Vector3d o = inBox(outer), d = (inBox(box) - o).normalized();
+		// slab test for the part of the ray inside the box
+		double tNear = 0, tFar = 1e300;
+		for (int c = 0; c < 3; c++)
+		{
+			double t1 = (box.min()[c] - o[c]) / d[c], t2 = (box.max()[c] - o[c]) / d[c];
+			tNear = std::max(tNear, std::min(t1, t2));
+			tFar = std::min(tFar, std::max(t1, t2));
+		}
+		for (int s = 0; s < samples; s++)
+		{
+			const Eigen::Vector3d p = o + (tNear + (tFar - tNear) * (s + 0.5) / samples) * d;
+			for (int c = 0; c < 3; c++) points[3 * ((size_t)r * samples + s) + c] = (float)p[c];
+		}
+	}
+	std::vector<float> shuffled(3 * n);
+	std::vector<size_t> permutation(n);
+	for (size_t i = 0; i < n; i++) permutation[i] = i;
+	std::shuffle(permutation.begin(), permutation.end(), rng);
+	for (size_t i = 0; i < n; i++)
+	{
+		for (int c = 0; c < 3; c++) shuffled[3 * i + c] = points[3 * permutation[i] + c];
+	}
+
+	printf("%d vertices, %d tets, BVH depth %d, build %.1f ms\n", (int)rest.size(), (int)tets.size(), field.locator().depth(), buildMs);
+	printf("%d rays x %d samples = %zu points, %d reps\n", rays, samples, n, reps);
+	printf("%18s %12s %12s %10s %10s %14s\n", "run", "ms/batch", "Mpoints/s", "inside", "mismatch", "max |d-dref|");
+	std::vector<float> displacements(3 * n);
+	std::vector<unsigned char> inside(n);
+	for (int run = 0; run < 4; run++)
+	{
+		const bool coherent = run % 2 == 1;
+		const std::vector<float>& batch = run < 2 ? points : shuffled;
+		size_t n_inside = 0;
+		t0 = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; r++) n_inside = field.query(batch.data(), n, displacements.data(), inside.data(), coherent);
+		const double ms = msSince(t0) / reps;
+
+		// every 97th point against a plain locate
+		int mismatch = 0;
+		double error = 0;
+		for (size_t i = 0; i < n; i += 97)
+		{
+			const Eigen::Vector3d p(batch[3 * i], batch[3 * i + 1], batch[3 * i + 2]);
+			const TetLocation location = field.locator().locate(p);
+			if (location.inside != (bool)inside[i])
+			{
+				mismatch++;
+				continue;
+			}
+			if (!location.inside) continue;
+			Eigen::Vector3d reference = Eigen::Vector3d::Zero();
+			for (int m = 0; m < 4; m++)
+			{
+				const int v = field.locator().tet(location.tet)[m];
+				reference += location.barycentric[m] * (deformed[v] - rest[v]);
+			}
+			error = std::max(error, (reference - Eigen::Vector3d(displacements[3 * i], displacements[3 * i + 1], displacements[3 * i + 2])).norm());
+		}
+		const char* name[] = { "rays, no cache", "rays, cache", "shuffled, no cache", "shuffled, cache" };
+		printf("%18s %12.2f %12.2f %9.1f%% %10d %14.3e\n", name[run], ms, n / ms * 1e-3, 100.0 * n_inside / n, mismatch, error);
+	}
+	return 0;
+}
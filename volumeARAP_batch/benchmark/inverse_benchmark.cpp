@@ -0,0 +1,141 @@
+// Per-frame cost of InverseDeformation over a deformation sequence: the refit of
+// the tree to the frame's deformed positions against a full rebuild, and the
+// throughput of ray-sample batches in deformed space on the refitted and on the
+// rebuilt tree. Rays run from random points around the deformed mesh's bounding
+// box towards random points inside it, sampled evenly over the part inside the
+// box. Results are checked against TetLocator::locate on a tree built for the
+// frame, on a subset. Without deformed meshes the rest mesh is twisted about z,
+// a little more every frame.
+//
+// inverse_benchmark [--rays n] [--samples n] [--frames n] restMesh [deformedMesh...]
+#include "InverseDeformation.h"
+#include "MyUtils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+static double msSince(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char *argv[])
+{
+	int rays = 5000, samples = 128, frames = 5;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--rays" && i + 1 < argc) rays = atoi(argv[++i]);
+		else if (arg == "--samples" && i + 1 < argc) samples = atoi(argv[++i]);
+		else if (arg == "--frames" && i + 1 < argc) frames = atoi(argv[++i]);
+		else files.push_back(arg);
+	}
+	if (files.empty())
+	{
+		std::cout << "inverse_benchmark [--rays n] [--samples n] [--frames n] restMesh [deformedMesh...]" << std::endl;
+		return 1;
+	}
+	std::vector<Eigen::Vector3d> rest;
+	std::vector<Eigen::Vector4i> tets;
+	if (!readTetMesh(files[0], rest, tets)) return 1;
+	if (files.size() > 1) frames = (int)files.size() - 1;
+	Eigen::AlignedBox3d restBox;
+	for (const Eigen::Vector3d& v : rest) restBox.extend(v);
+
+	InverseDeformation inverse, rebuilt;
+	auto t0 = std::chrono::steady_clock::now();
+	if (!inverse.build(rest, tets) || !rebuilt.build(rest, tets)) return 1;
+	printf("%d vertices, %d tets, build %.1f ms\n", (int)rest.size(), (int)tets.size(), msSince(t0));
+	printf("%d rays x %d samples = %d points per frame\n", rays, samples, rays * samples);
+	printf("%5s %10s %12s %8s %14s %14s %8s %10s %14s\n", "frame", "refit ms", "rebuild ms", "inside",
+		"refit Mpts/s", "rebuilt Mpts/s", "ratio", "mismatch", "max |r-rref|");
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> uniform(0, 1);
+	auto inBox = [&](const Eigen::AlignedBox3d& b) {
+		return Eigen::Vector3d(b.min() + b.sizes().cwiseProduct(Eigen::Vector3d(uniform(rng), uniform(rng), uniform(rng))));
+	};
+	const size_t n = (size_t)rays * samples;
+	std::vector<float> points(3 * n), restPoints(3 * n), rebuiltPoints(3 * n);
+	std::vector<unsigned char> inside(n), rebuiltInside(n);
+	std::vector<Eigen::Vector3d> deformed;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		if (files.size() > 1)
+		{
+			std::vector<Eigen::Vector4i> deformedTets;
+			if (!readTetMesh(files[frame + 1], deformed, deformedTets)) return 1;
+		}
+		else
+		{
+			// up to a half turn over the height at the last frame
+			const double twist = M_PI * (frame + 1) / frames, height = std::max(restBox.sizes().z(), 1e-300);
+			deformed.resize(rest.size());
+			for (int i = 0; i < rest.size(); i++)
+			{
+				deformed[i] = Eigen::AngleAxisd(twist * (rest[i].z() - restBox.min().z()) / height, Eigen::Vector3d::UnitZ()) * rest[i];
+			}
+		}
+		t0 = std::chrono::steady_clock::now();
+		if (!inverse.set_deformed(deformed)) return 1;
+		const double refitMs = msSince(t0);
+		if (!rebuilt.set_deformed(deformed)) return 1;
+		t0 = std::chrono::steady_clock::now();
+		rebuilt.rebuild();
+		const double rebuildMs = msSince(t0);
+
+		Eigen::AlignedBox3d box;
+		for (const Eigen::Vector3d& v : deformed) box.extend(v);
+		Eigen::AlignedBox3d outer(box.center() - box.sizes(), box.center() + box.sizes());
+		for (int r = 0; r < rays; r++)
+		{
+			const Eigen::Vector3d o = inBox(outer), d = (inBox(box) - o).normalized();
+			// slab test for the part of the ray inside the box
+			double tNear = 0, tFar = 1e300;
+			for (int c = 0; c < 3; c++)
+			{
+				double t1 = (box.min()[c] - o[c]) / d[c], t2 = (box.max()[c] - o[c]) / d[c];
+				tNear = std::max(tNear, std::min(t1, t2));
+				tFar = std::min(tFar, std::max(t1, t2));
+			}
+			for (int s = 0; s < samples; s++)
+			{
+				const Eigen::Vector3d p = o + (tNear + (tFar - tNear) * (s + 0.5) / samples) * d;
+				for (int c = 0; c < 3; c++) points[3 * ((size_t)r * samples + s) + c] = (float)p[c];
+			}
+		}
+
+		t0 = std::chrono::steady_clock::now();
+		const size_t n_inside = inverse.query(points.data(), n, restPoints.data(), inside.data());
+		const double refitQueryMs = msSince(t0);
+		t0 = std::chrono::steady_clock::now();
+		rebuilt.query(points.data(), n, rebuiltPoints.data(), rebuiltInside.data());
+		const double rebuiltQueryMs = msSince(t0);
+
+		// every 97th point against a plain locate on the rebuilt tree
+		int mismatch = 0;
+		double error = 0;
+		for (size_t i = 0; i < n; i += 97)
+		{
+			const Eigen::Vector3d p(points[3 * i], points[3 * i + 1], points[3 * i + 2]);
+			const TetLocation location = rebuilt.locator().locate(p);
+			if (location.inside != (bool)inside[i] || inside[i] != rebuiltInside[i])
+			{
+				mismatch++;
+				continue;
+			}
+			Eigen::Vector3d reference = p;
+			if (location.inside)
+			{
+				reference.setZero();
+				for (int m = 0; m < 4; m++) reference += location.barycentric[m] * rest[rebuilt.locator().tet(location.tet)[m]];
+			}
+			error = std::max(error, (reference - Eigen::Vector3d(restPoints[3 * i], restPoints[3 * i + 1], restPoints[3 * i + 2])).norm());
+		}
+		printf("%5d %10.2f %12.2f %7.1f%% %14.2f %14.2f %8.2f %10d %14.3e\n", frame, refitMs, rebuildMs,
+			100.0 * n_inside / n, n / refitQueryMs * 1e-3, n / rebuiltQueryMs * 1e-3, refitQueryMs / rebuiltQueryMs, mismatch, error);
+	}
+	return 0;
+}
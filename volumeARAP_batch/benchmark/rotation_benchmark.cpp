@@ -0,0 +1,120 @@
+// Local step time of the batched SIMD rotation kernels against the JacobiSVD fit
+// the local step started from and the scalar closed-form fitRotation(). The rest
+// mesh is deformed by a smooth twist plus per-vertex noise, so the covariances
+// are full rank but not already rotations; --flat collapses the neighbourhood of
+// every tenth vertex onto a plane, giving rank-2 covariances whose smallest
+// singular direction only gets its sign from det(R) = +1.
+// Deviations are the largest Frobenius distance to the JacobiSVD rotation and
+// the largest |R^T R - I| over all vertices.
+//
+// rotation_benchmark [--reps n] [--noise x] [--flat] mesh.ovm
+#include "ARAPDeform.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+
+static double msSince(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// the original local step: full 3x3 JacobiSVD, smallest singular direction flipped on reflections
+static void fitRotationsJacobiSVD(const ARAPAdjacency& adjacency, const std::vector<Eigen::Vector3d>& positions, std::vector<Eigen::Matrix3d>& R)
+{
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < adjacency.n_vertices(); i++)
+	{
+		Eigen::Matrix3d edgeMatrixSum = Eigen::Matrix3d::Zero();
+		for (int e = adjacency.offsets[i]; e < adjacency.offsets[i + 1]; e++)
+		{
+			edgeMatrixSum.noalias() += adjacency.rest_edges[e] * (positions[i] - positions[adjacency.neighbors[e]]).transpose();
+		}
+		Eigen::JacobiSVD<Eigen::Matrix3d> svd(edgeMatrixSum, Eigen::ComputeFullU | Eigen::ComputeFullV);
+		Eigen::Matrix3d U = svd.matrixU();
+		R[i] = svd.matrixV() * U.transpose();
+		if (R[i].determinant() < 0)
+		{
+			U.col(2) = -U.col(2);
+			R[i] = svd.matrixV() * U.transpose();
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int reps = 50;
+	double noise = 0.05;
+	bool flat = false;
+	std::string meshFile;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--reps" && i + 1 < argc) reps = atoi(argv[++i]);
+		else if (arg == "--noise" && i + 1 < argc) noise = atof(argv[++i]);
+		else if (arg == "--flat") flat = true;
+		else meshFile = arg;
+	}
+	if (meshFile.empty())
+	{
+		std::cout << "rotation_benchmark [--reps n] [--noise x] [--flat] mesh.ovm" << std::endl;
+		return 1;
+	}
+	TetrahedralMesh mesh;
+	if (!myReadFile(meshFile, mesh)) return 1;
+	std::ostringstream sink;
+	std::streambuf* coutBuf = std::cout.rdbuf(sink.rdbuf());
+	ARAPDeform arap(mesh, false);
+	std::cout.rdbuf(coutBuf);
+	const ARAPAdjacency& adjacency = arap.adjacency;
+	const int n_vertices = adjacency.n_vertices();
+
+	// twist about z by up to a quarter turn over the height, plus noise relative to the mean edge length
+	std::vector<Eigen::Vector3d> positions(n_vertices);
+	double zMin = 1e300, zMax = -1e300, edgeLength = 0;
+	for (int i = 0; i < n_vertices; i++)
+	{
+		positions[i] = OVtoE(mesh.vertex(VertexHandle(i)));
+		zMin = std::min(zMin, positions[i].z());
+		zMax = std::max(zMax, positions[i].z());
+	}
+	for (const Eigen::Vector3d& e : adjacency.rest_edges) edgeLength += e.norm();
+	edgeLength /= std::max(1, adjacency.n_half_edges());
+	std::mt19937 rng(1);
+	std::normal_distribution<double> gauss(0, noise * edgeLength);
+	for (int i = 0; i < n_vertices; i++)
+	{
+		const double angle = 0.5 * M_PI * (positions[i].z() - zMin) / std::max(zMax - zMin, 1e-300);
+		positions[i] = Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitZ()) * positions[i] + Eigen::Vector3d(gauss(rng), gauss(rng), gauss(rng));
+	}
+	if (flat)
+	{
+		for (int i = 0; i < n_vertices; i += 10)
+		{
+			for (int e = adjacency.offsets[i]; e < adjacency.offsets[i + 1]; e++) positions[adjacency.neighbors[e]].z() = positions[i].z();
+		}
+	}
+
+	std::vector<Eigen::Matrix3d> reference(n_vertices), R(n_vertices);
+	auto t0 = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++) fitRotationsJacobiSVD(adjacency, positions, reference);
+	const double svdMs = msSince(t0) / reps;
+
+	printf("%d vertices, %d half-edges, %d reps%s\n", n_vertices, adjacency.n_half_edges(), reps, flat ? ", flattened neighbourhoods" : "");
+	printf("%10s %12s %12s %10s %14s %14s\n", "kernel", "ms/step", "ns/vertex", "speedup", "max |R-Rsvd|", "max |RtR-I|");
+	printf("%10s %12.3f %12.1f %10.2f %14s %14s\n", "jacobisvd", svdMs, svdMs * 1e6 / n_vertices, 1.0, "-", "-");
+	for (ARAPRotationKernel kernel : availableRotationKernels())
+	{
+		t0 = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; r++) fitRotations(kernel, adjacency, positions, R);
+		const double ms = msSince(t0) / reps;
+		double deviation = 0, orthogonality = 0;
+		for (int i = 0; i < n_vertices; i++)
+		{
+			deviation = std::max(deviation, (R[i] - reference[i]).norm());
+			orthogonality = std::max(orthogonality, (R[i].transpose() * R[i] - Eigen::Matrix3d::Identity()).norm());
+		}
+		printf("%10s %12.3f %12.1f %10.2f %14.3e %14.3e\n", rotationKernelName(kernel), ms, ms * 1e6 / n_vertices, svdMs / ms, deviation, orthogonality);
+	}
+	return 0;
+}
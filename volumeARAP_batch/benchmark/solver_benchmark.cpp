@@ -0,0 +1,104 @@
+// Factorization and solve time of every sparse solver backend of this build, per
+// mesh. Each backend factorizes the mesh's system and runs the whole handle
+// sequence (warm-started, a fixed number of iterations per frame); the backend
+// with the lowest factorization + sequence time is reported per mesh size.
+// The deviation column is the largest vertex distance to the first backend's result.
+// Without --hard the matrix-free CG global step is timed as well; its memory
+// advantage shows in the "peak RSS" line of separate volumeARAP runs, not here.
+//
+// solver_benchmark [--iters n] [--hard] mesh1.ovm handleFile1 [mesh2.ovm handleFile2 ...]
+#include "ARAPDeform.h"
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+
+static double msSince(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char *argv[])
+{
+	int iters = 10;
+	bool hardConstrain = false;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--iters" && i + 1 < argc) iters = atoi(argv[++i]);
+		else if (arg == "--hard") hardConstrain = true;
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty() || inputs.size() % 2 != 0)
+	{
+		std::cout << "solver_benchmark [--iters n] [--hard] mesh1.ovm handleFile1 [mesh2.ovm handleFile2 ...]" << std::endl;
+		return 1;
+	}
+
+	// the solver logs every iteration on std::cout
+	std::ostringstream sink;
+	std::streambuf* coutBuf = std::cout.rdbuf(sink.rdbuf());
+
+	std::vector<std::pair<int, std::string>> fastest;
+	for (int m = 0; m + 1 < inputs.size(); m += 2)
+	{
+		TetrahedralMesh mesh;
+		if (!myReadFile(inputs[m].c_str(), mesh)) continue;
+		ARAPDeform base(mesh, hardConstrain);
+		std::ifstream iff(inputs[m + 1]);
+		base.loadConstPoint(iff);
+		const int frames = std::max((int)base.seq_constPoint.size(), 1);
+		sink.str("");
+
+		printf("%s: %d vertices, %d controls, %d frames, %d iterations/frame\n", inputs[m].c_str(),
+			(int)mesh.n_vertices(), (int)base.bary_vert_index.size(), frames, iters);
+		printf("%12s %12s %12s %12s %14s\n", "backend", "factor ms", "ms/frame", "total ms", "deviation");
+		std::vector<Eigen::Vector3d> reference;
+		double bestTotal = -1;
+		std::string best;
+		std::vector<std::string> names;
+		for (ARAPSolverBackend backend : availableSolverBackends()) names.push_back(solverBackendName(backend));
+		if (!hardConstrain) names.push_back("matrix-free");
+		for (const std::string& name : names)
+		{
+			ARAPDeform arap(mesh, base.adjacency, hardConstrain);
+			arap.set_controls(base.bary_vert_index, base.barycentric);
+			arap.matrixFree = !solverBackendFromName(name, arap.solver.backendType);
+			arap.maxIterTime = iters;
+			arap.tolerance = 0;  // always run the full iteration count
+			auto t0 = std::chrono::steady_clock::now();
+			if (!arap.prefactor())
+			{
+				std::cout.rdbuf(coutBuf);
+				printf("%12s %12s\n", name.c_str(), "failed");
+				std::cout.rdbuf(sink.rdbuf());
+				continue;
+			}
+			double factorMs = msSince(t0);
+			ARAPState state;
+			arap.init_state(state);
+			t0 = std::chrono::steady_clock::now();
+			for (int seq_id = 0; seq_id < base.seq_constPoint.size(); seq_id++)
+			{
+				arap.deform_frame(base.seq_constPoint[seq_id], state);
+				sink.str("");
+			}
+			double runMs = msSince(t0);
+			double deviation = 0;
+			if (reference.empty()) reference = state.positions;
+			for (int i = 0; i < reference.size(); i++) deviation = std::max(deviation, (state.positions[i] - reference[i]).norm());
+			printf("%12s %12.2f %12.2f %12.2f %14.3e\n", name.c_str(), factorMs, runMs / frames, factorMs + runMs, deviation);
+			if (bestTotal < 0 || factorMs + runMs < bestTotal)
+			{
+				bestTotal = factorMs + runMs;
+				best = name;
+			}
+		}
+		if (bestTotal >= 0) fastest.push_back(std::make_pair((int)mesh.n_vertices(), best));
+		printf("\n");
+	}
+	printf("fastest backend per mesh size:\n");
+	for (const auto& f : fastest) printf("%10d vertices: %s\n", f.first, f.second.c_str());
+	std::cout.rdbuf(coutBuf);
+	return 0;
+}
@@ -0,0 +1,156 @@
+#include "ARAPBatch.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <set>
+
+namespace {
+
+struct HandleJob
+{
+	std::string handleFile;
+	std::string outputFolder;
+	std::unique_ptr<ARAPHandleFile> handles;  // frames are read as the job runs
+	std::unique_ptr<ARAPFrameWriter> writer;
+	int group = -1;
+};
+
+bool sameControls(const HandleJob& a, const HandleJob& b)
+{
+	return a.handles->bary_vert_index == b.handles->bary_vert_index && a.handles->barycentric == b.handles->barycentric;
+}
+
+}
+
+int runARAPBatch(TetrahedralMesh& mesh, const std::vector<std::string>& handleFiles,
+	const std::string& outputFolder, const ARAPBatchOptions& options, ARAPProfile* profile)
+{
+	int failed = 0;
+	std::vector<HandleJob> jobs;
+	std::set<std::string> usedFolders;
+	ARAPPhaseTimer loadTimer(profile, ARAP_PHASE_LOAD);
+	for (const std::string& handleFile : handleFiles)
+	{
+		HandleJob job;
+		job.handleFile = handleFile;
+		job.handles.reset(new ARAPHandleFile());
+		if (!job.handles->open(handleFile) || !job.handles->checkVertices((int)mesh.n_vertices()))
+		{
+			failed++;
+			continue;
+		}
+		if (handleFiles.size() == 1)
+		{
+			job.outputFolder = outputFolder;
+		}
+		else
+		{
+			std::string stem = std::filesystem::path(handleFile).stem().string();
+			std::string folder = outputFolder + "/" + stem;
+			for (int k = 1; usedFolders.count(folder); k++) folder = outputFolder + "/" + stem + "_" + std::to_string(k);
+			usedFolders.insert(folder);
+			job.outputFolder = folder;
+		}
+		std::filesystem::create_directories(job.outputFolder);
+		jobs.push_back(std::move(job));
+	}
+	loadTimer.stop();
+
+	// adjacency and weights are shared by every factorization of this mesh
+	ARAPPhaseTimer weightTimer(profile, ARAP_PHASE_WEIGHTS);
+	ARAPDeform base(mesh, options.hardConstrain, options.weights);
+	weightTimer.stop();
+	if (!options.weightReport.empty()) base.weightReport.write(options.weightReport);
+
+	// one factorization per distinct barycentric control block
+	std::vector<std::unique_ptr<ARAPDeform>> groups;
+	std::vector<int> groupOwner;
+	for (int k = 0; k < jobs.size(); k++)
+	{
+		for (int g = 0; g < groups.size() && jobs[k].group < 0; g++)
+		{
+			if (sameControls(jobs[groupOwner[g]], jobs[k])) jobs[k].group = g;
+		}
+		if (jobs[k].group < 0)
+		{
+			jobs[k].group = (int)groups.size();
+			groups.emplace_back(new ARAPDeform(mesh, base.adjacency, options.hardConstrain));
+			groups.back()->set_controls(jobs[k].handles->bary_vert_index, jobs[k].handles->barycentric);
+			groups.back()->maxIterTime = options.maxIterTime;
+			groups.back()->tolerance = options.tolerance;
+			groups.back()->convergence = options.convergence;
+			groups.back()->andersonWindow = options.andersonWindow;
+			groups.back()->warmStart = options.warmStart;
+			groups.back()->solver.backendType = options.solverBackend;
+			groups.back()->solver.pcg = options.cg;
+			groups.back()->matrixFree = options.matrixFree;
+			groups.back()->matrixFreeSolver.options = options.cg;
+			groups.back()->mixedPrecision = options.mixedPrecision;
+			groups.back()->rotationKernel = options.rotationKernel;
+			groups.back()->solver.refinementSteps = options.refinementSteps;
+			groups.back()->profile = profile;
+			groupOwner.push_back(k);
+		}
+	}
+	std::cout << "batch: " << jobs.size() << " handle files, " << groups.size() << " factorizations" << std::endl;
+
+	ThreadPool pool(options.numThreads);
+	std::vector<char> factorized(groups.size(), 0);
+	for (int g = 0; g < groups.size(); g++)
+	{
+		pool.submit([&groups, &factorized, g]() { factorized[g] = groups[g]->prefactor(); });
+	}
+	pool.wait();
+
+	for (HandleJob& job : jobs)
+	{
+		const ARAPDeform* arap = groups[job.group].get();
+		if (!factorized[job.group])
+		{
+			std::cerr << "Error: factorization failed for " << job.handleFile << std::endl;
+			failed++;
+			continue;
+		}
+		job.writer.reset(new ARAPFrameWriter(mesh, job.outputFolder, options.outputFormat, profile));
+		if (options.independentFrames)
+		{
+			for (int seq_id = 0; seq_id < job.handles->frames(); seq_id++)
+			{
+				pool.submit([&job, arap, seq_id]() {
+					ARAPState state;
+					arap->init_state(state);
+					std::vector<Eigen::Vector3d> frameBuffer;
+					auto t0 = std::chrono::steady_clock::now();
+					ARAPFrameReport report = arap->deform_frame(job.handles->frame(seq_id, frameBuffer), state);
+					arap->record_frame(seq_id, report, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+					std::cout << job.handleFile + " " + arapFrameSummary(seq_id, report) + "\n";
+					job.writer->write(seq_id, state.positions);
+				});
+			}
+		}
+		else
+		{
+			pool.submit([&job, arap]() {
+				ARAPState state;
+				arap->init_state(state);
+				std::vector<Eigen::Vector3d> frameBuffer;
+				for (int seq_id = 0; seq_id < job.handles->frames(); seq_id++)
+				{
+					auto t0 = std::chrono::steady_clock::now();
+					ARAPFrameReport report = arap->deform_frame(job.handles->frame(seq_id, frameBuffer), state);
+					arap->record_frame(seq_id, report, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+					std::cout << job.handleFile + " " + arapFrameSummary(seq_id, report) + "\n";
+					job.writer->write(seq_id, state.positions);
+				}
+			});
+		}
+	}
+	pool.wait();
+	for (HandleJob& job : jobs)
+	{
+		if (job.writer && !job.writer->finish()) failed++;
+	}
+	return failed;
+}
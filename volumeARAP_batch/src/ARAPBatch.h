@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ARAPDeform.h"
+#include <string>
+#include <vector>
+
+struct ARAPBatchOptions
+{
+	bool hardConstrain = false;
+	int numThreads = 0;  // <= 0: one per hardware thread
+	// start every frame from the rest pose and run frames as separate jobs,
+	// instead of warm-starting each frame from the previous one of its file
+	bool independentFrames = false;
+	// per-frame iteration control, copied onto every factorization group
+	int maxIterTime = 10;
+	double tolerance = 1e-4;
+	ARAPConvergence convergence = ARAP_MAX_DISPLACEMENT;
+	int andersonWindow = 0;
+	bool warmStart = true;
+	ARAPOutputFormat outputFormat = ARAP_OUTPUT_OVM;
+	ARAPSolverBackend solverBackend = ARAP_SOLVER_LDLT;
+	bool matrixFree = false;  // CG on the adjacency instead of a factorization, soft constraints only
+	ARAPPCGOptions cg;  // stopping rule of the pcg backend and of the matrix-free solver
+	bool mixedPrecision = false;  // float local step and rhs (see ARAPDeform::mixedPrecision)
+	ARAPRotationKernel rotationKernel = detectRotationKernel();  // local step rotation fit (see ARAPDeform::rotationKernel)
+	int refinementSteps = 0;  // iterative refinement steps of the global solve (see ARAPSolver)
+	ARAPWeightOptions weights;
+	std::string weightReport;  // if set, the JSON weight diagnostics of the mesh are written here
+	std::string profile;  // if set, the run's ARAPProfile is written here (.json, or a row appended to a .csv)
+};
+
+// Deform one mesh under several handle files. Adjacency and weights are computed
+// once; handle files with the same barycentric control block share one
+// factorization. Files (or frames, with independentFrames) run concurrently on a
+// thread pool, each job with its own ARAPState. Results are written to
+// <outputFolder> for a single handle file, and to <outputFolder>/<handle file stem>
+// otherwise, by one ARAPFrameWriter per handle file.
+// Phase times, counters and frames of every job go to profile, if set.
+// Returns the number of handle files that failed.
+int runARAPBatch(TetrahedralMesh& mesh, const std::vector<std::string>& handleFiles,
+	const std::string& outputFolder, const ARAPBatchOptions& options, ARAPProfile* profile = nullptr);
@@ -2,21 +2,123 @@
 
 //#include "MatEngine.h"
 #include "MyUtils.h"
+#include "ARAPSolver.h"
+#include "ARAPMatrixFree.h"
+#include "ARAPRotationKernel.h"
+#include "ARAPProfile.h"
+#include "AndersonAcceleration.h"
+#include "ARAPHandleFile.h"
+#include "ARAPFrameWriter.h"
 #include <Eigen/Sparse>
 #include <iostream>
 #include <fstream>
+#include <functional>
 
-typedef Eigen::Triplet<double> Tri;
+// Flat CSR snapshot of the vertex-vertex adjacency of the rest mesh, built once by the
+// ARAPDeform constructor. The outgoing half-edges (i, j) of vertex i are the entries
+// offsets[i] .. offsets[i + 1] - 1 of the parallel arrays below.
+struct ARAPAdjacency
+{
+	std::vector<int> offsets;  // n_vertices + 1
+	std::vector<int> neighbors;  // j
+	std::vector<Eigen::Vector3d> rest_edges;  // p_i - p_j in the rest pose
+	std::vector<double> weights;  // dihedral cotangent weight
+
+	int n_vertices() const { return (int)offsets.size() - 1; }
+	int n_half_edges() const { return (int)neighbors.size(); }
+	int degree(int i) const { return offsets[i + 1] - offsets[i]; }
+};
+
+// how the ARAPDeform constructor turns the dihedral cotangents of the rest tets into edge weights
+struct ARAPWeightOptions
+{
+	// tets of lower quality (sqrt(2) * 6 * volume / rms edge length^3, 1 for a regular tet)
+	// or with non-finite cotangents contribute nothing; edges left without any tet get the
+	// mean absolute weight of the mesh
+	double degenerateQuality = 1e-8;
+	double maxWeight = 1e4;  // |weight| is clamped to this
+	bool enforcePositive = false;  // raise weights below minWeight to minWeight
+	double minWeight = 1e-4;
+};
+
+// Degenerate tets and modified edge weights found by the ARAPDeform constructor
+struct ARAPWeightReport
+{
+	struct Cell
+	{
+		int tet;
+		Eigen::Vector4i vertices;
+		double quality;
+	};
+	struct Edge
+	{
+		int i, j;
+		double raw;  // mean cotangent over the valid tets, NaN if there were none
+		double weight;  // the weight used
+		const char* reason;  // "no valid tet", "non-finite", "clamped" or "raised to minimum"
+	};
+	int n_vertices = 0;
+	int n_tets = 0;
+	int n_edges = 0;
+	double minWeight = 0;  // range of the final weights
+	double maxWeight = 0;
+	std::vector<Cell> degenerateCells;
+	std::vector<Edge> edges;  // every undirected edge whose weight was replaced or clamped, once
+
+	// false if any tet was degenerate or any edge weight had to be replaced
+	bool ok() const;
+	std::string summary() const;
+	bool write(const std::string& filename) const;  // JSON
+};
+
+// Buffers of one deformation job: rotations, positions and the solver's
+// right-hand side / solution. Jobs sharing one factorized ARAPDeform each
+// own an ARAPState, so they can run concurrently.
+struct ARAPState
+{
+	std::vector<Eigen::Matrix3d> Rots;
+	std::vector<Eigen::Vector3d> positions;
+	RowMatrixXd B;
+	RowMatrixXd ATb;
+	RowMatrixXd x;
+	AndersonAcceleration anderson;
+	// single-precision copies used inside a frame with ARAPDeform::mixedPrecision
+	std::vector<Eigen::Matrix3f> RotsF;
+	std::vector<Eigen::Vector3f> positionsF;
+};
+
+enum ARAPConvergence
+{
+	ARAP_MAX_DISPLACEMENT,  // largest vertex move of one iteration / rest bounding box diagonal
+	ARAP_ENERGY  // relative change of the global least-squares energy between iterations
+};
+
+// outcome of ARAPDeform::deform_frame
+struct ARAPFrameReport
+{
+	int iterations = 0;
+	double residual = 0;  // value of the convergence criterion after the last iteration
+	double energy = 0;  // only evaluated with ARAP_ENERGY
+	int rejected = 0;  // Anderson steps that increased the fixed-point residual and were undone
+	bool converged = false;
+};
+
+// parse a handle file: per-frame control point positions, then the barycentric block
+bool readConstPoint(std::istream& cin, std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	std::vector<Eigen::Vector4i>& bary_vert_index, std::vector<Eigen::Vector4d>& barycentric);
+
+// <outputFolder>/arap_result_XXXX_.ovm
+std::string arapResultName(const std::string& outputFolder, int seq_id);
+
+// "frame N: k iterations, residual r (converged)"
+std::string arapFrameSummary(int seq_id, const ARAPFrameReport& report);
 
 class ARAPDeform
 {
 public:
 	TetrahedralMesh * mesh;
-	int half_edge_num;
-	std::vector<int> degree;
-	std::vector<Eigen::Vector3d> edgeijs;  // edgeijs vector
-	std::vector<double> edge_weights;
-	std::vector<int> edge_index;  // first neighbour edge index
+	ARAPAdjacency adjacency;
+	ARAPWeightReport weightReport;  // filled by the weight computation of the constructor
 	std::vector<std::pair<int, int>> edge_pairs;
 	std::vector<bool> isConst;
 	std::vector<int> isConst_i;
@@ -41,21 +143,94 @@ public:
 
 	// for eigen solve
 	std::vector<Tri> tripletList;
-	Eigen::VectorXd vectorB;
+	ARAPSolver solver;  // factorized once, reused for every frame and every job sharing the controls
+	// with matrixFree (soft controls only), A^T*A is never assembled and the global step runs CG on the adjacency
+	bool matrixFree;
+	ARAPMatrixFreeSolver matrixFreeSolver;
+	// control edits past this many low-rank terms refactorize A^T*A instead
+	int maxLowRankTerms;
+	// Run the local step and the half-edge rows of the right-hand side in float; A^T*A
+	// stays factorized and solved in double and state.Rots is widened back at the end of
+	// a frame. Each float rhs row is off by a few 2^-24 * w * |e| (rounding of R, of the
+	// rest edge and of the deformed edges R is fitted to), which the global solve spreads
+	// like any rhs perturbation and warm-started frames carry over: on 20^3 test boxes
+	// the positions stay within 3e-5 of the bounding box diagonal of the double pipeline
+	// over 20 iterations x all frames, below the default frame tolerance of 1e-4.
+	bool mixedPrecision;
+	// kernel of the double local step, the widest the CPU supports unless set otherwise
+	ARAPRotationKernel rotationKernel;
+	// vertices held where the state's positions put them, not solved for (see ARAPSolver::fixedColumns);
+	// set before prefactor(), not with matrixFree
+	std::vector<int> pinned;
 
-	int maxIterTime;
+	int maxIterTime;  // upper bound of local/global iterations per frame
+	double tolerance;  // a frame stops once the convergence criterion drops to this value
+	ARAPConvergence convergence;
+	int andersonWindow;  // > 0: Anderson-accelerate the local/global iterations over this many previous steps
+	bool warmStart;  // start every frame from the previous frame's positions and rotations, otherwise from the rest pose
+	double bbox_diagonal;  // rest pose, scales ARAP_MAX_DISPLACEMENT
 	bool hardConstrain;
+	// factor one |V|x|V| system and solve x, y, z as three right-hand sides, with hard constraints
+	// eliminated through a Schur complement (see ARAPSolver); otherwise the interleaved 3|V| system
+	bool separateAxes;
+	ARAPOutputFormat outputFormat;  // how yyj_ARAPDeform writes the frames (see ARAPFrameWriter)
+	// if set, phase times and counters of prefactor() and the frames go here; not owned
+	ARAPProfile* profile;
 
 	ARAPDeform() {};
-	ARAPDeform(TetrahedralMesh& mesh, bool hardConstrain = true);
+	ARAPDeform(TetrahedralMesh& mesh, bool hardConstrain = true, const ARAPWeightOptions& weightOptions = ARAPWeightOptions());
+	// reuse the adjacency and weights already computed for the same mesh
+	ARAPDeform(TetrahedralMesh& mesh, const ARAPAdjacency& adjacency, bool hardConstrain = true);
 	~ARAPDeform();
+	void init(bool hardConstrain);
 	void loadConstPoint(std::istream& cin);
+	void set_controls(const std::vector<Eigen::Vector4i>& tets, const std::vector<Eigen::Vector4d>& barys);
 	void setConstPoint(int i, Eigen::Vector3d v);
 	void global_step_pre(TetrahedralMesh& deformed_mesh);
 	void eigen_global_step_pre(TetrahedralMesh& deformed_mesh);
-	void local_step(std::vector<Eigen::Matrix3d>& R, TetrahedralMesh& deformed_mesh);
-	void yyj_ARAPDeform(std::string &handlefile, std::string outputFolder);
+	void eigen_global_step_pre_axis();
+	void local_step(std::vector<Eigen::Matrix3d>& R, const std::vector<Eigen::Vector3d>& positions) const;
+	void assemble_rhs(const std::vector<Eigen::Matrix3d>& R, const std::vector<Eigen::Vector3d>& constPoint, double* b) const;
+	// the same on a job's state, in float with mixedPrecision (state.RotsF instead of state.Rots)
+	void local_step(ARAPState& state) const;
+	void assemble_rhs(const ARAPState& state, const std::vector<Eigen::Vector3d>& constPoint, double* b) const;
+	// assemble the global system of the loaded controls and factorize it
+	bool prefactor();
+	// Edit the controls of a prefactored system: the factor is kept and the change is
+	// carried as a low-rank term (see ARAPSolver). Frames passed to deform_frame
+	// afterwards hold one position per current control, in order; removing control k
+	// shifts the later ones down. add_control returns the new index, -1 on failure.
+	int add_control(const Eigen::Vector4i& tet, const Eigen::Vector4d& bary);
+	bool remove_control(int k);
+	// rest positions, identity rotations and solver buffers sized for this->solver
+	void init_state(ARAPState& state) const;
+	// start from the given positions, with the rotations of their local step; pinned vertices stay there
+	void set_positions(ARAPState& state, const std::vector<Eigen::Vector3d>& positions) const;
+	// local/global iterations towards one frame of control positions, until convergence or maxIterTime
+	ARAPFrameReport deform_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPState& state) const;
+	// at most maxIter iterations starting from state as it is; state.Rots must be the local step of state.positions
+	ARAPFrameReport iterate_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPState& state, int maxIter) const;
+	double energy(const std::vector<Eigen::Matrix3d>& R, const std::vector<Eigen::Vector3d>& positions, const std::vector<Eigen::Vector3d>& frameConstPoint) const;
+	// add a finished frame of a sequence to profile, if set
+	void record_frame(int seq_id, const ARAPFrameReport& report, double ms) const;
+	// deform every frame of a text or binary handle file (see ARAPHandleFile); false if the
+	// handle file cannot be used, the system cannot be factored or a frame cannot be written
+	bool yyj_ARAPDeform(std::string &handlefile, std::string outputFolder);
 	//bool yyj_LeastSquareSolve(Utility::MatEngine &matEngine, int rowNum, int colNum, int Annz, int *rowPtr, int *colPtr, double *valPtr, const double *b, double *x);
 	//bool yyj_CholeskyPre(Utility::MatEngine &matEngine, int rowNum, int colNum, int Annz, int *rowPtr, int *colPtr, double *valPtr);
 	//bool yyj_CholeskySolve(Utility::MatEngine &matEngine, int rowNum, int colNum, const double *b, double *x);
+
+private:
+	// apply a control edit to the factorized system, or refactorize if it cannot be low-rank
+	bool update_controls(const std::function<bool()>& lowRankEdit);
+	// sizes and nnz of the prefactored system, to profile
+	void record_system() const;
+	// state.Rots = state.RotsF
+	void widen_rotations(ARAPState& state) const;
+	// control rows of the right-hand side, after the half-edge rows
+	void assemble_control_rhs(const std::vector<Eigen::Vector3d>& constPoint, double* b) const;
+
+	// float copies of adjacency.rest_edges and weights for mixedPrecision, filled by prefactor()
+	std::vector<Eigen::Vector3f> rest_edges_f;
+	std::vector<float> weights_f;
 };
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "ARAPFrameWriter.h"
+#include "ARAPDeform.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+static const char framesMagic[8] = { 'A', 'R', 'A', 'P', 'F', 'R', 'M', '\0' };
+
+ARAPFrameWriter::ARAPFrameWriter(TetrahedralMesh& mesh, const std::string& outputFolder, ARAPOutputFormat format, ARAPProfile* profile, int maxQueued)
+	:mesh(mesh), outputFolder(outputFolder), format(format), profile(profile), maxQueued(std::max(maxQueued, 1))
+{
+	const int n_vertices = (int)mesh.n_vertices();
+	if (format == ARAP_OUTPUT_DELTAS)
+	{
+		rest.resize(n_vertices);
+		for (int i = 0; i < n_vertices; i++) rest[i] = OVtoE(mesh.vertex(VertexHandle(i)));
+	}
+	if (format != ARAP_OUTPUT_OVM)
+	{
+		memcpy(header.magic, framesMagic, sizeof(framesMagic));
+		header.version = 1;
+		header.format = format;
+		header.n_vertices = n_vertices;
+		header.n_frames = 0;
+		header.frames_offset = sizeof(header);
+		frames.open((outputFolder + "/arap_frames.bin").c_str(), std::ios::binary | std::ios::trunc);
+		frames.write((const char*)&header, sizeof(header));
+		floatBuffer.resize(n_vertices * 3);
+	}
+	worker = std::thread([this]() { this->run(); });
+}
+
+ARAPFrameWriter::~ARAPFrameWriter()
+{
+	this->finish();
+}
+
+void ARAPFrameWriter::write(int seq_id, const std::vector<Eigen::Vector3d>& positions)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	slotAvailable.wait(lock, [this]() { return queue.size() < maxQueued; });
+	Frame frame;
+	frame.seq_id = seq_id;
+	if (!spare.empty())
+	{
+		frame.positions.swap(spare.back());
+		spare.pop_back();
+	}
+	frame.positions.assign(positions.begin(), positions.end());
+	queue.push_back(std::move(frame));
+	frameAvailable.notify_one();
+}
+
+bool ARAPFrameWriter::finish()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (finished) return ok;
+		finished = true;
+		stopping = true;
+	}
+	frameAvailable.notify_all();
+	worker.join();
+
+	if (format != ARAP_OUTPUT_OVM)
+	{
+		// the frame count is only known now
+		frames.seekp(0);
+		frames.write((const char*)&header, sizeof(header));
+		frames.close();
+		ok = ok && !frames.fail();
+	}
+	if (!ok)
+	{
+		std::cerr << "Error: could not write every frame to " << outputFolder << std::endl;
+	}
+	else if (n_written > 0)
+	{
+		std::cout << "wrote " << n_written << " frames to " << outputFolder << ", "
+			<< writeMs / n_written << " ms/frame on the I/O thread" << std::endl;
+	}
+	return ok;
+}
+
+void ARAPFrameWriter::run()
+{
+	if (format != ARAP_OUTPUT_OVM)
+	{
+		// positions of the topology file are the rest pose
+		ok = myWriteFile(outputFolder + "/arap_topology.ovm", mesh);
+	}
+	while (true)
+	{
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			frameAvailable.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty()) return;
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+		auto t0 = std::chrono::steady_clock::now();
+		ARAPPhaseTimer timer(profile, ARAP_PHASE_WRITE);
+		this->writeFrame(frame);
+		timer.stop();
+		writeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		n_written++;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			spare.push_back(std::move(frame.positions));
+		}
+		slotAvailable.notify_one();
+	}
+}
+
+void ARAPFrameWriter::writeFrame(const Frame& frame)
+{
+	if (format == ARAP_OUTPUT_OVM)
+	{
+		ok = myWriteFile(arapResultName(outputFolder, frame.seq_id), mesh, frame.positions) && ok;
+		return;
+	}
+	const int n_vertices = (int)header.n_vertices;
+	for (int i = 0; i < n_vertices; i++)
+	{
+		Eigen::Vector3d p = format == ARAP_OUTPUT_DELTAS ? Eigen::Vector3d(frame.positions[i] - rest[i]) : frame.positions[i];
+		Eigen::Map<Eigen::Vector3f>(floatBuffer.data() + i * 3) = p.cast<float>();
+	}
+	frames.seekp(header.frames_offset + (uint64_t)frame.seq_id * n_vertices * 3 * sizeof(float));
+	frames.write((const char*)floatBuffer.data(), floatBuffer.size() * sizeof(float));
+	ok = ok && !frames.fail();
+	header.n_frames = std::max(header.n_frames, (uint64_t)frame.seq_id + 1);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "MyUtils.h"
+#include "ARAPProfile.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum ARAPOutputFormat
+{
+	ARAP_OUTPUT_OVM,  // one ASCII arap_result_XXXX_.ovm per frame
+	ARAP_OUTPUT_POSITIONS,  // arap_topology.ovm once, then float32 positions per frame in arap_frames.bin
+	ARAP_OUTPUT_DELTAS  // arap_topology.ovm once, then float32 (deformed - rest) per frame in arap_frames.bin
+};
+
+// Header of arap_frames.bin, little-endian, version 1. Frame i is the float32
+// xyz array of n_vertices vertices at frames_offset + i * n_vertices * 12 bytes.
+struct ARAPFramesHeader
+{
+	char magic[8];  // "ARAPFRM" + '\0'
+	uint32_t version;
+	uint32_t format;  // ARAP_OUTPUT_POSITIONS or ARAP_OUTPUT_DELTAS
+	uint64_t n_vertices;
+	uint64_t n_frames;  // 1 + the largest frame index written
+	uint64_t frames_offset;
+};
+
+// Writes the frames of one sequence on a background I/O thread. write() copies
+// the positions into a queue and returns; it only blocks while maxQueued frames
+// are still waiting for the disk. Frames may arrive in any order and from
+// several threads, binary frames land at their fixed-stride slot. With a profile,
+// the time of every frame on the I/O thread goes to its write phase.
+class ARAPFrameWriter
+{
+public:
+	ARAPFrameWriter(TetrahedralMesh& mesh, const std::string& outputFolder, ARAPOutputFormat format, ARAPProfile* profile = nullptr, int maxQueued = 4);
+	ARAPFrameWriter(const ARAPFrameWriter&) = delete;
+	ARAPFrameWriter& operator=(const ARAPFrameWriter&) = delete;
+	~ARAPFrameWriter();
+	void write(int seq_id, const std::vector<Eigen::Vector3d>& positions);
+	// write every queued frame, finalize the header and stop the I/O thread; false on I/O errors
+	bool finish();
+
+private:
+	struct Frame
+	{
+		int seq_id;
+		std::vector<Eigen::Vector3d> positions;
+	};
+	void run();
+	void writeFrame(const Frame& frame);
+
+	TetrahedralMesh& mesh;
+	std::string outputFolder;
+	ARAPOutputFormat format;
+	ARAPProfile* profile;
+	int maxQueued;
+	std::vector<Eigen::Vector3d> rest;  // ARAP_OUTPUT_DELTAS only
+	std::ofstream frames;
+	ARAPFramesHeader header;
+	std::vector<float> floatBuffer;
+
+	std::deque<Frame> queue;
+	std::vector<std::vector<Eigen::Vector3d>> spare;  // recycled position buffers
+	std::mutex mutex;
+	std::condition_variable frameAvailable;
+	std::condition_variable slotAvailable;
+	bool stopping = false;
+	bool finished = false;
+	std::thread worker;
+
+	// written by the I/O thread, read after it has joined
+	bool ok = true;
+	int n_written = 0;
+	double writeMs = 0;
+};
@@ -0,0 +1,259 @@
+#include "ARAPHandleFile.h"
+#include "ARAPDeform.h"
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char handleMagic[8] = { 'A', 'R', 'A', 'P', 'H', 'D', 'L', '\0' };
+static const uint32_t handleVersion = 1;
+
+static bool checkHandleSizes(const std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	const std::vector<Eigen::Vector4i>& bary_vert_index, const std::vector<Eigen::Vector4d>& barycentric);
+
+bool isBinaryHandleFile(const std::string& filename)
+{
+	std::ifstream iff(filename.c_str(), std::ios::binary);
+	char magic[8];
+	return iff.read(magic, sizeof(magic)) && memcmp(magic, handleMagic, sizeof(magic)) == 0;
+}
+
+ARAPHandleFile::~ARAPHandleFile()
+{
+	this->close();
+}
+
+void ARAPHandleFile::close()
+{
+#ifndef _WIN32
+	if (mapped != nullptr && fileData.empty()) munmap((void*)mapped, mappedSize);
+#endif
+	mapped = nullptr;
+	mappedSize = 0;
+	framePositions = nullptr;
+	std::vector<char>().swap(fileData);
+	std::vector<std::vector<Eigen::Vector3d>>().swap(seq_constPoint);
+	bary_vert_index.clear();
+	barycentric.clear();
+	n_frames = 0;
+}
+
+bool ARAPHandleFile::open(const std::string& filename)
+{
+	this->close();
+	if (!isBinaryHandleFile(filename))
+	{
+		std::ifstream iff(filename.c_str());
+		if (!iff.good() || !readConstPoint(iff, seq_constPoint, bary_vert_index, barycentric))
+		{
+			std::cerr << "Error: could not read handle file " << filename << std::endl;
+			this->close();
+			return false;
+		}
+		if (!checkHandleSizes(seq_constPoint, bary_vert_index, barycentric))
+		{
+			std::cerr << "Error: inconsistent handle file " << filename << std::endl;
+			this->close();
+			return false;
+		}
+		n_frames = (int)seq_constPoint.size();
+		return true;
+	}
+
+#ifndef _WIN32
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	struct stat st;
+	if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			mapped = (const char*)p;
+			mappedSize = (size_t)st.st_size;
+			// frames are consumed front to back
+			madvise(p, mappedSize, MADV_SEQUENTIAL);
+		}
+	}
+	if (fd >= 0) ::close(fd);
+#endif
+	if (mapped == nullptr)
+	{
+		std::ifstream iff(filename.c_str(), std::ios::binary);
+		fileData.assign(std::istreambuf_iterator<char>(iff), std::istreambuf_iterator<char>());
+		mapped = fileData.data();
+		mappedSize = fileData.size();
+	}
+
+	ARAPHandleHeader header;
+	if (mappedSize < sizeof(header))
+	{
+		std::cerr << "Error: truncated handle file " << filename << std::endl;
+		this->close();
+		return false;
+	}
+	memcpy(&header, mapped, sizeof(header));
+	// bounded counts first, so that none of the sizes below can overflow
+	if (header.n_controls > (uint64_t)INT_MAX || header.n_frames > (uint64_t)INT_MAX)
+	{
+		std::cerr << "Error: corrupt handle file " << filename << " (" << header.n_frames << " frames of "
+			<< header.n_controls << " control points)" << std::endl;
+		this->close();
+		return false;
+	}
+	const uint64_t blocksEnd = sizeof(header) + header.n_controls * (4 * sizeof(int32_t) + 4 * sizeof(double));
+	const uint64_t frameSize = header.n_controls * 3 * sizeof(double);
+	if (header.version != handleVersion || header.frames_offset < blocksEnd || header.frames_offset % sizeof(double) != 0
+		|| header.frames_offset > mappedSize
+		|| (frameSize > 0 && header.n_frames > (mappedSize - header.frames_offset) / frameSize))
+	{
+		std::cerr << "Error: unsupported or truncated handle file " << filename << " (version " << header.version << ")" << std::endl;
+		this->close();
+		return false;
+	}
+
+	const int n_controls = (int)header.n_controls;
+	bary_vert_index.resize(n_controls);
+	barycentric.resize(n_controls);
+	const char* tets = mapped + sizeof(header);
+	const char* barys = tets + n_controls * 4 * sizeof(int32_t);
+	for (int i = 0; i < n_controls; i++)
+	{
+		int32_t t[4];
+		memcpy(t, tets + i * sizeof(t), sizeof(t));
+		bary_vert_index[i] = Eigen::Vector4i(t[0], t[1], t[2], t[3]);
+		memcpy(barycentric[i].data(), barys + i * 4 * sizeof(double), 4 * sizeof(double));
+	}
+	framePositions = (const double*)(mapped + header.frames_offset);
+	n_frames = (int)header.n_frames;
+	std::cout << "mapped " << n_frames << " frames of " << n_controls << " control points" << std::endl;
+	return true;
+}
+
+const std::vector<Eigen::Vector3d>& ARAPHandleFile::frame(int seq_id, std::vector<Eigen::Vector3d>& buffer) const
+{
+	if (!isBinary()) return seq_constPoint[seq_id];
+	const int n_controls = (int)bary_vert_index.size();
+	buffer.resize(n_controls);
+	Eigen::Map<const Eigen::Matrix<double, 3, Eigen::Dynamic>> positions(framePositions + (size_t)seq_id * n_controls * 3, 3, n_controls);
+	for (int i = 0; i < n_controls; i++) buffer[i] = positions.col(i);
+	return buffer;
+}
+
+bool ARAPHandleFile::checkVertices(int n_vertices) const
+{
+	for (int i = 0; i < (int)bary_vert_index.size(); i++)
+	{
+		const Eigen::Vector4i& t = bary_vert_index[i];
+		if (t.minCoeff() < 0 || t.maxCoeff() >= n_vertices)
+		{
+			std::cerr << "Error: control point " << i << " refers to tet (" << t[0] << " " << t[1] << " " << t[2] << " " << t[3]
+				<< ") outside a mesh of " << n_vertices << " vertices" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// every frame, and the barycentric rows, have one entry per control
+static bool checkHandleSizes(const std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	const std::vector<Eigen::Vector4i>& bary_vert_index, const std::vector<Eigen::Vector4d>& barycentric)
+{
+	const size_t n_controls = bary_vert_index.size();
+	if (barycentric.size() != n_controls)
+	{
+		std::cerr << "Error: " << bary_vert_index.size() << " tets but " << barycentric.size() << " barycentric rows" << std::endl;
+		return false;
+	}
+	for (int i = 0; i < (int)seq_constPoint.size(); i++)
+	{
+		if (seq_constPoint[i].size() != n_controls)
+		{
+			std::cerr << "Error: frame " << i << " has " << seq_constPoint[i].size() << " positions for "
+				<< n_controls << " control points" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool writeBinaryHandleFile(const std::string& filename, const std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	const std::vector<Eigen::Vector4i>& bary_vert_index, const std::vector<Eigen::Vector4d>& barycentric)
+{
+	if (!checkHandleSizes(seq_constPoint, bary_vert_index, barycentric)) return false;
+	const size_t n_controls = bary_vert_index.size();
+
+	ARAPHandleHeader header;
+	memcpy(header.magic, handleMagic, sizeof(handleMagic));
+	header.version = handleVersion;
+	header.reserved = 0;
+	header.n_frames = seq_constPoint.size();
+	header.n_controls = n_controls;
+	header.frames_offset = sizeof(header) + n_controls * (4 * sizeof(int32_t) + 4 * sizeof(double));
+
+	std::ofstream off(filename.c_str(), std::ios::binary);
+	off.write((const char*)&header, sizeof(header));
+	for (const Eigen::Vector4i& t : bary_vert_index)
+	{
+		int32_t v[4] = { t[0], t[1], t[2], t[3] };
+		off.write((const char*)v, sizeof(v));
+	}
+	for (const Eigen::Vector4d& b : barycentric) off.write((const char*)b.data(), 4 * sizeof(double));
+	for (const std::vector<Eigen::Vector3d>& frame : seq_constPoint)
+	{
+		off.write((const char*)frame.data(), frame.size() * 3 * sizeof(double));
+	}
+	if (!off.good())
+	{
+		std::cerr << "Error: could not write handle file " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool writeTextHandleFile(const std::string& filename, const std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	const std::vector<Eigen::Vector4i>& bary_vert_index, const std::vector<Eigen::Vector4d>& barycentric)
+{
+	if (!checkHandleSizes(seq_constPoint, bary_vert_index, barycentric)) return false;
+	std::ofstream off(filename.c_str());
+	off.precision(10);
+	off << seq_constPoint.size() << "\n";
+	for (const std::vector<Eigen::Vector3d>& frame : seq_constPoint)
+	{
+		off << frame.size() << "\n";
+		for (const Eigen::Vector3d& p : frame) off << p[0] << " " << p[1] << " " << p[2] << "\n";
+	}
+	off << bary_vert_index.size() << "\n";
+	for (int i = 0; i < (int)bary_vert_index.size(); i++)
+	{
+		const Eigen::Vector4i& t = bary_vert_index[i];
+		const Eigen::Vector4d& b = barycentric[i];
+		off << t[0] << " " << t[1] << " " << t[2] << " " << t[3] << "\n";
+		off << b[0] << " " << b[1] << " " << b[2] << " " << b[3] << "\n";
+	}
+	if (!off.good())
+	{
+		std::cerr << "Error: could not write handle file " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool convertHandleFile(const std::string& textFile, const std::string& binaryFile)
+{
+	std::vector<std::vector<Eigen::Vector3d>> seq_constPoint;
+	std::vector<Eigen::Vector4i> bary_vert_index;
+	std::vector<Eigen::Vector4d> barycentric;
+	std::ifstream iff(textFile.c_str());
+	if (!iff.good() || !readConstPoint(iff, seq_constPoint, bary_vert_index, barycentric))
+	{
+		std::cerr << "Error: could not read handle file " << textFile << std::endl;
+		return false;
+	}
+	return writeBinaryHandleFile(binaryFile, seq_constPoint, bary_vert_index, barycentric);
+}
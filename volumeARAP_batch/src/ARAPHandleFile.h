@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary handle file, little-endian, version 1:
+//   ARAPHandleHeader
+//   n_controls x int32[4]     tet vertex indices (bary_vert_index)
+//   n_controls x double[4]    barycentric coordinates
+//   n_frames x n_controls x double[3], starting at frames_offset
+// Every frame block has the same stride, so frame i is found without reading
+// the frames before it.
+struct ARAPHandleHeader
+{
+	char magic[8];  // "ARAPHDL" + '\0'
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t n_frames;
+	uint64_t n_controls;
+	uint64_t frames_offset;  // byte offset of the first frame block
+};
+
+// A handle file opened for frame-by-frame reading. Binary files are memory-mapped
+// and every frame is copied out of the mapping when asked for; text files (the
+// format of readConstPoint) are parsed into memory on open. Reading frames only
+// touches const state, so concurrent jobs may share one ARAPHandleFile as long as
+// each of them passes its own buffer.
+class ARAPHandleFile
+{
+public:
+	std::vector<Eigen::Vector4i> bary_vert_index;
+	std::vector<Eigen::Vector4d> barycentric;
+
+	ARAPHandleFile() {};
+	ARAPHandleFile(const ARAPHandleFile&) = delete;
+	ARAPHandleFile& operator=(const ARAPHandleFile&) = delete;
+	~ARAPHandleFile();
+	// either format, told apart by the binary magic
+	bool open(const std::string& filename);
+	void close();
+
+	int frames() const { return n_frames; }
+	bool isBinary() const { return mapped != nullptr; }
+	// control positions of frame seq_id: the in-memory frame of a text file, or
+	// buffer filled from the mapping of a binary one
+	const std::vector<Eigen::Vector3d>& frame(int seq_id, std::vector<Eigen::Vector3d>& buffer) const;
+	// true if every control tet vertex is a vertex of a mesh with n_vertices vertices;
+	// the file itself cannot know, so callers check before set_controls
+	bool checkVertices(int n_vertices) const;
+
+private:
+	int n_frames = 0;
+	std::vector<std::vector<Eigen::Vector3d>> seq_constPoint;  // text files only
+	const char* mapped = nullptr;
+	size_t mappedSize = 0;
+	const double* framePositions = nullptr;
+	std::vector<char> fileData;  // without mmap, the whole binary file
+};
+
+// true if filename starts with the binary handle magic
+bool isBinaryHandleFile(const std::string& filename);
+
+// write a binary handle file; every frame must hold one position per control
+bool writeBinaryHandleFile(const std::string& filename, const std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	const std::vector<Eigen::Vector4i>& bary_vert_index, const std::vector<Eigen::Vector4d>& barycentric);
+
+// write a text handle file, the format readConstPoint reads
+bool writeTextHandleFile(const std::string& filename, const std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	const std::vector<Eigen::Vector4i>& bary_vert_index, const std::vector<Eigen::Vector4d>& barycentric);
+
+// text handle file -> binary handle file
+bool convertHandleFile(const std::string& textFile, const std::string& binaryFile);
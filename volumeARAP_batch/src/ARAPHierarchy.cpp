@@ -0,0 +1,285 @@
+#include "ARAPHierarchy.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+static long long cellKey(const Eigen::Vector3i& c, const Eigen::Vector3i& dims)
+{
+	return ((long long)c[2] * dims[1] + c[1]) * dims[0] + c[0];
+}
+
+ARAPHierarchy::ARAPHierarchy(ARAPDeform& fine, int n_levels, double coarsening) :fine(fine)
+{
+	coarseIterTime = fine.maxIterTime;
+	fineIterTime = 2;
+
+	TetrahedralMesh& mesh = *fine.mesh;
+	const int n_vertices = (int)mesh.n_vertices();
+	std::vector<Eigen::Vector3d> rest(n_vertices);
+	Eigen::Vector3d bbMax = Eigen::Vector3d::Constant(-std::numeric_limits<double>::max());
+	origin = -bbMax;
+	for (int i = 0; i < n_vertices; i++)
+	{
+		rest[i] = OVtoE(mesh.vertex(VertexHandle(i)));
+		origin = origin.cwiseMin(rest[i]);
+		bbMax = bbMax.cwiseMax(rest[i]);
+	}
+	double meanEdge = 0;
+	for (const Eigen::Vector3d& e : fine.adjacency.rest_edges) meanEdge += e.norm();
+	meanEdge /= std::max((int)fine.adjacency.rest_edges.size(), 1);
+	if (n_vertices == 0 || meanEdge <= 0) return;
+
+	double cellSize = coarsening * meanEdge;
+	for (int k = 0; k < n_levels; k++, cellSize *= 2)
+	{
+		levels.emplace_back();
+		ARAPLevel& level = levels.back();
+		level.cellSize = cellSize;
+		for (int a = 0; a < 3; a++) level.dims[a] = (int)std::floor((bbMax[a] - origin[a]) / cellSize) + 1;
+
+		// cells overlapping the bounding box of a fine tet (or holding a fine vertex);
+		// further levels take the parents of the previous level's cells
+		std::vector<char> mark((size_t)level.dims.prod(), 0);
+		std::vector<Eigen::Vector3i> occupied;
+		auto occupy = [&](const Eigen::Vector3i& c) {
+			char& m = mark[cellKey(c, level.dims)];
+			if (!m) { m = 1; occupied.push_back(c); }
+		};
+		if (k == 0)
+		{
+			for (int i = 0; i < n_vertices; i++) occupy(cellOf(level, rest[i]));
+			for (OpenVolumeMesh::CellIter c_it = mesh.cells_begin(); c_it != mesh.cells_end(); ++c_it)
+			{
+				Eigen::Vector3i lo = Eigen::Vector3i::Constant(std::numeric_limits<int>::max()), hi = -lo;
+				for (OpenVolumeMesh::CellVertexIter cv_it = mesh.cv_iter(*c_it); cv_it.valid(); ++cv_it)
+				{
+					Eigen::Vector3i c = cellOf(level, rest[cv_it->idx()]);
+					lo = lo.cwiseMin(c);
+					hi = hi.cwiseMax(c);
+				}
+				for (int z = lo[2]; z <= hi[2]; z++)
+					for (int y = lo[1]; y <= hi[1]; y++)
+						for (int x = lo[0]; x <= hi[0]; x++) occupy(Eigen::Vector3i(x, y, z));
+			}
+		}
+		else
+		{
+			for (const Eigen::Vector3i& c : levels[k - 1].cells) occupy(Eigen::Vector3i(c[0] / 2, c[1] / 2, c[2] / 2));
+		}
+		if (k > 0 && occupied.size() == levels[k - 1].cells.size())
+		{
+			// no further reduction
+			levels.pop_back();
+			break;
+		}
+		buildLevel(level, occupied);
+
+		// embed the next finer level
+		if (k == 0)
+		{
+			level.prolong_tets.resize(n_vertices);
+			level.prolong_barys.resize(n_vertices);
+			for (int i = 0; i < n_vertices; i++)
+			{
+				locate(level, rest[i], cellOf(level, rest[i]), level.prolong_tets[i], level.prolong_barys[i]);
+			}
+		}
+		else
+		{
+			const ARAPLevel& finer = levels[k - 1];
+			const int n_finer = (int)finer.vertex_cells.size();
+			level.prolong_tets.resize(n_finer);
+			level.prolong_barys.resize(n_finer);
+			for (int i = 0; i < n_finer; i++)
+			{
+				// the parent of an occupied cell contains all of it, including its corners
+				const Eigen::Vector3i& c = finer.vertex_cells[i];
+				locate(level, OVtoE(finer.mesh->vertex(VertexHandle(i))), Eigen::Vector3i(c[0] / 2, c[1] / 2, c[2] / 2),
+					level.prolong_tets[i], level.prolong_barys[i]);
+			}
+		}
+		std::cout << "ARAP level " << k + 1 << ": " << level.mesh->n_vertices() << " vertices, "
+			<< level.mesh->n_cells() << " tets" << std::endl;
+		if (occupied.size() == 1) break;
+	}
+}
+
+Eigen::Vector3i ARAPHierarchy::cellOf(const ARAPLevel& level, const Eigen::Vector3d& x) const
+{
+	Eigen::Vector3i c;
+	for (int a = 0; a < 3; a++)
+	{
+		c[a] = std::min(std::max((int)std::floor((x[a] - origin[a]) / level.cellSize), 0), level.dims[a] - 1);
+	}
+	return c;
+}
+
+void ARAPHierarchy::buildLevel(ARAPLevel& level, const std::vector<Eigen::Vector3i>& occupied)
+{
+	level.cells = occupied;
+	const Eigen::Vector3i vdims = level.dims + Eigen::Vector3i::Ones();
+	std::vector<int> gridVertex((size_t)vdims.prod(), -1);
+	std::vector<Eigen::Vector3d> verts;
+	std::vector<Eigen::Vector4i> tets;
+	auto vertexAt = [&](const Eigen::Vector3i& g, const Eigen::Vector3i& cell) {
+		int& v = gridVertex[cellKey(g, vdims)];
+		if (v < 0)
+		{
+			v = (int)verts.size();
+			verts.push_back(origin + level.cellSize * g.cast<double>());
+			level.vertex_cells.push_back(cell);
+		}
+		return v;
+	};
+	static const int perms[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+	for (const Eigen::Vector3i& c : occupied)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			// walk from the cell's min corner to its max corner, one axis at a time
+			Eigen::Vector3i g = c;
+			Eigen::Vector4i t;
+			t[0] = vertexAt(g, c);
+			for (int a = 0; a < 3; a++)
+			{
+				g[perms[p][a]]++;
+				t[a + 1] = vertexAt(g, c);
+			}
+			// odd permutations give negatively oriented tets
+			if (p == 1 || p == 2 || p == 5) std::swap(t[2], t[3]);
+			tets.push_back(t);
+		}
+	}
+	level.grid_vertices.swap(gridVertex);
+	level.mesh.reset(new TetrahedralMesh());
+	buildTetMesh(*level.mesh, verts, tets);
+	level.arap.reset(new ARAPDeform(*level.mesh, false));
+}
+
+void ARAPHierarchy::locate(const ARAPLevel& level, const Eigen::Vector3d& x, const Eigen::Vector3i& cell,
+	Eigen::Vector4i& tet, Eigen::Vector4d& bary) const
+{
+	const Eigen::Vector3i vdims = level.dims + Eigen::Vector3i::Ones();
+	Eigen::Vector3d u = ((x - origin) / level.cellSize - cell.cast<double>()).cwiseMax(0.0).cwiseMin(1.0);
+	// the Kuhn tet containing u is the one whose walk takes the axes by decreasing u
+	int p[3] = { 0, 1, 2 };
+	std::sort(p, p + 3, [&u](int a, int b) { return u[a] > u[b]; });
+	bary = Eigen::Vector4d(1 - u[p[0]], u[p[0]] - u[p[1]], u[p[1]] - u[p[2]], u[p[2]]);
+	Eigen::Vector3i g = cell;
+	tet[0] = level.grid_vertices[cellKey(g, vdims)];
+	for (int a = 0; a < 3; a++)
+	{
+		g[p[a]]++;
+		tet[a + 1] = level.grid_vertices[cellKey(g, vdims)];
+	}
+}
+
+bool ARAPHierarchy::prefactor()
+{
+	// control k sits at sum(barycentric[k] * rest positions of its fine tet)
+	const int n_controls = (int)fine.controlpoint_number.size();
+	std::vector<Eigen::Vector3d> controls(n_controls, Eigen::Vector3d::Zero());
+	for (int i = 0; i < n_controls; i++)
+	{
+		const Eigen::Vector4i& t = fine.bary_vert_index[fine.controlpoint_number[i].first];
+		for (int m = 0; m < 4; m++) controls[i] += fine.barycentric[i][m] * OVtoE(fine.mesh->vertex(VertexHandle(t[m])));
+	}
+	bool ok = true;
+	for (ARAPLevel& level : levels)
+	{
+		std::vector<Eigen::Vector4i> tets(n_controls);
+		std::vector<Eigen::Vector4d> barys(n_controls);
+		for (int i = 0; i < n_controls; i++) locate(level, controls[i], cellOf(level, controls[i]), tets[i], barys[i]);
+		ARAPDeform& arap = *level.arap;
+		arap.set_controls(tets, barys);
+		arap.tolerance = fine.tolerance;
+		arap.convergence = fine.convergence;
+		arap.andersonWindow = fine.andersonWindow;
+		arap.solver.backendType = fine.solver.backendType;
+		arap.solver.pcg = fine.solver.pcg;
+		arap.matrixFree = fine.matrixFree;
+		arap.matrixFreeSolver.options = fine.matrixFreeSolver.options;
+		arap.mixedPrecision = fine.mixedPrecision;
+		arap.rotationKernel = fine.rotationKernel;
+		arap.profile = fine.profile;
+		arap.solver.refinementSteps = fine.solver.refinementSteps;
+		ok = ok && arap.prefactor();
+	}
+	// last, so that the system sizes in the profile are those of the fine mesh
+	ok = fine.prefactor() && ok;
+	return ok;
+}
+
+void ARAPHierarchy::init_state(ARAPHierarchyState& state) const
+{
+	state.levels.resize(levels.size() + 1);
+	fine.init_state(state.levels[0]);
+	for (int k = 0; k < levels.size(); k++) levels[k].arap->init_state(state.levels[k + 1]);
+}
+
+ARAPFrameReport ARAPHierarchy::deform_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPHierarchyState& state) const
+{
+	if (!fine.warmStart)
+	{
+		this->init_state(state);
+	}
+	state.previous.resize(levels.size());
+	for (int k = 0; k < levels.size(); k++) state.previous[k] = state.levels[k + 1].positions;
+	for (int k = (int)levels.size() - 1; k >= 0; k--)
+	{
+		const ARAPLevel& level = levels[k];
+		ARAPState& coarse = state.levels[k + 1];
+		level.arap->iterate_frame(frameConstPoint, coarse, coarseIterTime);
+
+		// add the whole displacement of this level in this frame (prolongated from the
+		// coarser levels and refined here) to the next finer level, keeping whatever
+		// detail that level carried over from the previous frame
+		const std::vector<Eigen::Vector3d>& previous = state.previous[k];
+		ARAPState& finer = state.levels[k];
+		const int n_finer = (int)finer.positions.size();
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < n_finer; i++)
+		{
+			const Eigen::Vector4i& t = level.prolong_tets[i];
+			for (int m = 0; m < 4; m++)
+			{
+				finer.positions[i] += level.prolong_barys[i][m] * (coarse.positions[t[m]] - previous[t[m]]);
+			}
+		}
+		const ARAPDeform& finerArap = k == 0 ? fine : *levels[k - 1].arap;
+		finerArap.local_step(finer.Rots, finer.positions);
+	}
+	return fine.iterate_frame(frameConstPoint, state.levels[0], fineIterTime);
+}
+
+bool ARAPHierarchy::yyj_ARAPDeform(std::string& handlefile, std::string outputFolder)
+{
+	ARAPHandleFile handles;
+	ARAPPhaseTimer loadTimer(fine.profile, ARAP_PHASE_LOAD);
+	if (!handles.open(handlefile) || !handles.checkVertices((int)fine.mesh->n_vertices()))
+	{
+		return false;
+	}
+	loadTimer.stop();
+	fine.set_controls(handles.bary_vert_index, handles.barycentric);
+	if (!this->prefactor())
+	{
+		return false;
+	}
+	ARAPHierarchyState state;
+	this->init_state(state);
+
+	ARAPFrameWriter writer(*fine.mesh, outputFolder, fine.outputFormat, fine.profile);
+	std::vector<Eigen::Vector3d> frameBuffer;
+	for (int seq_id = 0; seq_id < handles.frames(); seq_id++) {
+		std::cout << "processing the " << seq_id << " deformation" << std::endl;
+		auto t0 = std::chrono::steady_clock::now();
+		ARAPFrameReport report = this->deform_frame(handles.frame(seq_id, frameBuffer), state);
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		fine.record_frame(seq_id, report, ms);
+		std::cout << "Frame Time:" << ms << "ms" << std::endl;
+		std::cout << arapFrameSummary(seq_id, report) << std::endl;
+		writer.write(seq_id, state.levels[0].positions);
+	}
+	return writer.finish();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ARAPDeform.h"
+#include <memory>
+
+// One coarse level of an ARAPHierarchy: the cells of a regular grid that overlap
+// the fine cage, each split into the 6 tets of its Kuhn subdivision. The vertices
+// of the next finer level are embedded in its tets with the same tet index +
+// barycentric coordinates representation as control points.
+struct ARAPLevel
+{
+	double cellSize;
+	Eigen::Vector3i dims;  // cells per axis
+	std::vector<Eigen::Vector3i> cells;  // occupied cells
+	std::vector<int> grid_vertices;  // grid point -> vertex, -1 if no occupied cell uses it
+	std::vector<Eigen::Vector3i> vertex_cells;  // an occupied cell of every vertex
+	std::unique_ptr<TetrahedralMesh> mesh;
+	std::unique_ptr<ARAPDeform> arap;
+	// vertex i of the next finer level lies in the tet prolong_tets[i] of this level
+	std::vector<Eigen::Vector4i> prolong_tets;
+	std::vector<Eigen::Vector4d> prolong_barys;
+};
+
+struct ARAPHierarchyState
+{
+	std::vector<ARAPState> levels;  // [0]: the fine mesh, [k + 1]: ARAPHierarchy::levels[k]
+	std::vector<std::vector<Eigen::Vector3d>> previous;  // [k]: positions of levels[k] before the current frame
+};
+
+// Coarse-to-fine ARAP. Every frame is first solved on the coarsest grid, its
+// displacement is prolongated to the next finer level through the barycentric
+// embedding and refined there, down to a few iterations on the fine mesh.
+// Coarse levels always use soft controls: several controls may fall into one
+// coarse tet, which would make hard constraints contradictory.
+class ARAPHierarchy
+{
+public:
+	ARAPDeform& fine;
+	Eigen::Vector3d origin;  // grid origin, the rest bounding box minimum
+	std::vector<ARAPLevel> levels;  // finest coarse level first
+	int coarseIterTime;  // iterations per coarse level and frame
+	int fineIterTime;  // iterations on the fine mesh per frame
+
+	// n_levels grids, the first with cells of coarsening times the mean fine edge length,
+	// each further one twice as coarse; stops early once a grid is a single cell
+	ARAPHierarchy(ARAPDeform& fine, int n_levels, double coarsening = 2.0);
+	// embed the fine controls in every level and factorize all levels
+	bool prefactor();
+	void init_state(ARAPHierarchyState& state) const;
+	ARAPFrameReport deform_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPHierarchyState& state) const;
+	// same as ARAPDeform::yyj_ARAPDeform, solving every frame coarse-to-fine
+	bool yyj_ARAPDeform(std::string& handlefile, std::string outputFolder);
+
+private:
+	void buildLevel(ARAPLevel& level, const std::vector<Eigen::Vector3i>& occupied);
+	// the tet of level containing x, searched in the given occupied cell
+	void locate(const ARAPLevel& level, const Eigen::Vector3d& x, const Eigen::Vector3i& cell,
+		Eigen::Vector4i& tet, Eigen::Vector4d& bary) const;
+	Eigen::Vector3i cellOf(const ARAPLevel& level, const Eigen::Vector3d& x) const;
+};
@@ -0,0 +1,194 @@
+#include "ARAPMatrixFree.h"
+#include "ARAPDeform.h"
+#include <iostream>
+
+namespace {
+
+// per-lane sum of a[i] * b[i]
+Eigen::Array4d laneDot(const std::vector<Eigen::Array4d>& a, const std::vector<Eigen::Array4d>& b)
+{
+	Eigen::Array4d sum = Eigen::Array4d::Zero();
+#pragma omp parallel
+	{
+		Eigen::Array4d local = Eigen::Array4d::Zero();
+#pragma omp for schedule(static) nowait
+		for (int i = 0; i < (int)a.size(); i++) local += a[i] * b[i];
+#pragma omp critical
+		sum += local;
+	}
+	return sum;
+}
+
+}
+
+bool ARAPMatrixFreeSolver::init(const ARAPAdjacency& adjacency, const std::vector<Eigen::Vector4i>& tets, const std::vector<Eigen::Vector4d>& barys)
+{
+	this->adjacency = &adjacency;
+	this->tets = tets;
+	this->barys = barys;
+	n_vertices = adjacency.n_vertices();
+	n_rows = adjacency.n_half_edges() + (int)tets.size();
+	initialized = false;
+
+	// the adjacency is symmetric: every half-edge has its opposite in the neighbour's list
+	const int n_half_edges = adjacency.n_half_edges();
+	twin.assign(n_half_edges, -1);
+	stencil.resize(n_half_edges);
+	bool symmetric = true;
+#pragma omp parallel for schedule(static) reduction(&&:symmetric)
+	for (int i = 0; i < n_vertices; i++)
+	{
+		for (int e = adjacency.offsets[i]; e < adjacency.offsets[i + 1]; e++)
+		{
+			const int j = adjacency.neighbors[e];
+			for (int f = adjacency.offsets[j]; f < adjacency.offsets[j + 1]; f++)
+			{
+				if (adjacency.neighbors[f] == i)
+				{
+					twin[e] = f;
+					break;
+				}
+			}
+			symmetric = symmetric && twin[e] >= 0;
+			stencil[e] = twin[e] >= 0 ? adjacency.weights[e] * adjacency.weights[e] + adjacency.weights[twin[e]] * adjacency.weights[twin[e]] : 0;
+		}
+	}
+	if (!symmetric)
+	{
+		std::cerr << "Error: matrix-free solver needs a symmetric vertex adjacency!" << std::endl;
+		return false;
+	}
+
+	// vertex -> control rows touching it
+	controlOffsets.assign(n_vertices + 1, 0);
+	for (const Eigen::Vector4i& t : tets)
+	{
+		for (int k = 0; k < 4; k++) controlOffsets[t[k] + 1]++;
+	}
+	for (int i = 0; i < n_vertices; i++) controlOffsets[i + 1] += controlOffsets[i];
+	controlRows.resize(controlOffsets[n_vertices]);
+	controlWeights.resize(controlOffsets[n_vertices]);
+	std::vector<int> fill(controlOffsets.begin(), controlOffsets.end() - 1);
+	for (int r = 0; r < tets.size(); r++)
+	{
+		for (int k = 0; k < 4; k++)
+		{
+			const int slot = fill[tets[r][k]]++;
+			controlRows[slot] = r;
+			controlWeights[slot] = barys[r][k];
+		}
+	}
+
+	// Jacobi preconditioner: diagonal of A^T*A
+	inverseDiagonal.resize(n_vertices);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++)
+	{
+		double d = 0;
+		for (int e = adjacency.offsets[i]; e < adjacency.offsets[i + 1]; e++) d += stencil[e];
+		for (int k = controlOffsets[i]; k < controlOffsets[i + 1]; k++) d += controlWeights[k] * controlWeights[k];
+		inverseDiagonal[i] = d > 0 ? 1.0 / d : 1.0;
+	}
+	std::cout << "matrix-free global step: " << n_vertices << " unknowns, " << n_half_edges << " half-edges, "
+		<< tets.size() << " control rows" << std::endl;
+	initialized = true;
+	return true;
+}
+
+void ARAPMatrixFreeSolver::apply(const std::vector<Eigen::Array4d>& x, std::vector<Eigen::Array4d>& y, std::vector<Eigen::Array4d>& controlValues) const
+{
+	// y = A^T*A*x = L^T*L*x + C^T*(C*x)
+	const ARAPAdjacency& adj = *adjacency;
+#pragma omp parallel for schedule(static)
+	for (int r = 0; r < (int)tets.size(); r++)
+	{
+		controlValues[r] = barys[r][0] * x[tets[r][0]] + barys[r][1] * x[tets[r][1]] + barys[r][2] * x[tets[r][2]] + barys[r][3] * x[tets[r][3]];
+	}
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++)
+	{
+		const Eigen::Array4d xi = x[i];
+		Eigen::Array4d acc = Eigen::Array4d::Zero();
+		for (int e = adj.offsets[i]; e < adj.offsets[i + 1]; e++) acc += stencil[e] * (xi - x[adj.neighbors[e]]);
+		for (int k = controlOffsets[i]; k < controlOffsets[i + 1]; k++) acc += controlWeights[k] * controlValues[controlRows[k]];
+		y[i] = acc;
+	}
+}
+
+int ARAPMatrixFreeSolver::solve(const RowMatrixXd& B, RowMatrixXd& ATb, RowMatrixXd& x) const
+{
+	const ARAPAdjacency& adj = *adjacency;
+	const int n_half_edges = adj.n_half_edges();
+	if (x.rows() != n_vertices || x.cols() != 3) x.setZero(n_vertices, 3);
+	ATb.resize(n_vertices, 3);
+
+	std::vector<Eigen::Array4d> b(n_vertices), xs(n_vertices), r(n_vertices), z(n_vertices), p(n_vertices), q(n_vertices);
+	std::vector<Eigen::Array4d> controlValues(tets.size());
+
+	// b = A^T*B: outgoing half-edge rows minus the opposite ones, plus the control rows
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++)
+	{
+		Eigen::Array4d acc = Eigen::Array4d::Zero();
+		for (int e = adj.offsets[i]; e < adj.offsets[i + 1]; e++)
+		{
+			const int t = twin[e];
+			acc.head<3>() += adj.weights[e] * B.row(e).transpose().array() - adj.weights[t] * B.row(t).transpose().array();
+		}
+		for (int k = controlOffsets[i]; k < controlOffsets[i + 1]; k++)
+		{
+			acc.head<3>() += controlWeights[k] * B.row(n_half_edges + controlRows[k]).transpose().array();
+		}
+		b[i] = acc;
+		ATb.row(i) = acc.head<3>().transpose();
+		xs[i] << x.row(i).transpose(), 0.0;
+	}
+
+	// three independent preconditioned CG solves, one per lane
+	this->apply(xs, q, controlValues);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++)
+	{
+		r[i] = b[i] - q[i];
+		z[i] = inverseDiagonal[i] * r[i];
+		p[i] = z[i];
+	}
+	const Eigen::Array4d threshold = options.tolerance * options.tolerance * laneDot(b, b);
+	Eigen::Array4d rz = laneDot(r, z);
+	Eigen::Array4d rr = laneDot(r, r);
+	int iterations = 0;
+	for (; iterations < options.maxIterations && (rr > threshold).any(); iterations++)
+	{
+		this->apply(p, q, controlValues);
+		const Eigen::Array4d pq = laneDot(p, q);
+		const Eigen::Array4d alpha = (pq > 0).select(rz / pq, 0.0);
+		Eigen::Array4d rrNew = Eigen::Array4d::Zero(), rzNew = Eigen::Array4d::Zero();
+#pragma omp parallel
+		{
+			Eigen::Array4d localRR = Eigen::Array4d::Zero(), localRZ = Eigen::Array4d::Zero();
+#pragma omp for schedule(static) nowait
+			for (int i = 0; i < n_vertices; i++)
+			{
+				xs[i] += alpha * p[i];
+				r[i] -= alpha * q[i];
+				z[i] = inverseDiagonal[i] * r[i];
+				localRR += r[i] * r[i];
+				localRZ += r[i] * z[i];
+			}
+#pragma omp critical
+			{
+				rrNew += localRR;
+				rzNew += localRZ;
+			}
+		}
+		const Eigen::Array4d beta = (rz > 0).select(rzNew / rz, 0.0);
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < n_vertices; i++) p[i] = z[i] + beta * p[i];
+		rr = rrNew;
+		rz = rzNew;
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++) x.row(i) = xs[i].head<3>().transpose();
+	return iterations;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ARAPSolverBackend.h"
+#include <Eigen/Dense>
+#include <vector>
+
+struct ARAPAdjacency;
+
+// Matrix-free counterpart of ARAPSolver for the per-axis system (soft controls only).
+// A (one row per half-edge, one per control) is never assembled: A^T*B and
+// A^T*A*x are applied straight from the CSR adjacency, each half-edge (i, j)
+// contributing (w_ij^2 + w_ji^2) * (x_i - x_j) to row i, and the control rows
+// through a vertex -> control CSR. x, y and z run as three simultaneous CG
+// solves on 4-wide rows (the fourth lane is padding), so every stencil update
+// is one SIMD packet. The preconditioner is the diagonal of A^T*A; in this
+// layout the 3x3 vertex blocks of the interleaved system are diagonal, so block
+// Jacobi reduces to it. Memory is O(half-edges) with no fill-in.
+//
+// solve() has the interface of ARAPSolver::solve and keeps no state, so several
+// jobs may share one instance; x is the initial guess.
+class ARAPMatrixFreeSolver
+{
+public:
+	ARAPPCGOptions options;
+
+	ARAPMatrixFreeSolver() {};
+	// the adjacency must outlive the solver
+	bool init(const ARAPAdjacency& adjacency, const std::vector<Eigen::Vector4i>& tets, const std::vector<Eigen::Vector4d>& barys);
+	// x = (A^T*A)^-1 * A^T * B with B of size rows() x 3; returns the CG iterations
+	int solve(const RowMatrixXd& B, RowMatrixXd& ATb, RowMatrixXd& x) const;
+
+	int rows() const { return n_rows; }
+	int cols() const { return n_vertices; }
+	int rhsCols() const { return 3; }
+	bool isInitialized() const { return initialized; }
+
+private:
+	void apply(const std::vector<Eigen::Array4d>& x, std::vector<Eigen::Array4d>& y, std::vector<Eigen::Array4d>& controlValues) const;
+
+	const ARAPAdjacency* adjacency = nullptr;
+	std::vector<int> twin;  // half-edge (j, i) of every half-edge (i, j)
+	std::vector<double> stencil;  // w_ij^2 + w_ji^2
+	std::vector<Eigen::Vector4i> tets;
+	std::vector<Eigen::Vector4d> barys;
+	std::vector<int> controlOffsets;  // vertex -> (control, barycentric) entries
+	std::vector<int> controlRows;
+	std::vector<double> controlWeights;
+	std::vector<double> inverseDiagonal;
+	int n_vertices = 0;
+	int n_rows = 0;
+	bool initialized = false;
+};
@@ -0,0 +1,204 @@
+#include "ARAPProfile.h"
+#include "MyUtils.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// every counter a run may set, in the column order of CSV profiles
+static const char* const csvCounters[] = {
+	"vertices", "half_edges", "controls", "unknowns", "rows", "nnz_A", "nnz_AtA",
+	"iterations", "rejected_steps", "cg_iterations", "frames", "converged_frames", "max_residual", "peak_rss_mb"
+};
+
+static double wallMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* phaseName(ARAPPhase phase)
+{
+	switch (phase)
+	{
+	case ARAP_PHASE_LOAD: return "load";
+	case ARAP_PHASE_WEIGHTS: return "weights";
+	case ARAP_PHASE_TRIPLETS: return "triplets";
+	case ARAP_PHASE_FACTORIZE: return "factorize";
+	case ARAP_PHASE_RHS: return "rhs";
+	case ARAP_PHASE_SOLVE: return "solve";
+	case ARAP_PHASE_LOCAL: return "local";
+	case ARAP_PHASE_WRITE: return "write";
+	default: return "unknown";
+	}
+}
+
+void ARAPProfile::add(ARAPPhase phase, double wallMs, double cpuMs)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	phases[phase].calls++;
+	phases[phase].wallMs += wallMs;
+	phases[phase].cpuMs += cpuMs;
+}
+
+double& ARAPProfile::slot(const std::string& counter)
+{
+	for (auto& c : counters)
+	{
+		if (c.first == counter) return c.second;
+	}
+	counters.push_back(std::make_pair(counter, 0.0));
+	return counters.back().second;
+}
+
+void ARAPProfile::set(const std::string& counter, double value)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	slot(counter) = value;
+}
+
+void ARAPProfile::increment(const std::string& counter, double value)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	slot(counter) += value;
+}
+
+void ARAPProfile::addFrame(int seq_id, int iterations, double residual, bool converged, double wallMs)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	frames.push_back({ seq_id, iterations, residual, converged, wallMs });
+	slot("frames") += 1;
+	slot("converged_frames") += converged;
+	double& maxResidual = slot("max_residual");
+	maxResidual = std::max(maxResidual, residual);
+}
+
+ARAPProfile::Phase ARAPProfile::phase(ARAPPhase phase) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return phases[phase];
+}
+
+double ARAPProfile::counter(const std::string& counter) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const auto& c : counters)
+	{
+		if (c.first == counter) return c.second;
+	}
+	return 0;
+}
+
+std::string ARAPProfile::summary() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ostringstream oss;
+	oss << "phase        calls      wall ms       cpu ms\n";
+	char line[128];
+	for (int p = 0; p < ARAP_PHASE_COUNT; p++)
+	{
+		snprintf(line, sizeof(line), "%-10s %7lld %12.3f %12.3f\n", phaseName((ARAPPhase)p), phases[p].calls, phases[p].wallMs, phases[p].cpuMs);
+		oss << line;
+	}
+	for (int k = 0; k < counters.size(); k++)
+	{
+		oss << (k ? ", " : "") << counters[k].first << " " << counters[k].second;
+	}
+	return oss.str();
+}
+
+bool ARAPProfile::write(const std::string& filename) const
+{
+	const bool csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+	return csv ? this->writeCSV(filename) : this->writeJSON(filename);
+}
+
+bool ARAPProfile::writeJSON(const std::string& filename) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ofstream off(filename.c_str());
+	off << "{\n  \"phases\": {";
+	for (int p = 0; p < ARAP_PHASE_COUNT; p++)
+	{
+		off << (p ? ",\n    \"" : "\n    \"") << phaseName((ARAPPhase)p) << "\": {\"calls\": " << phases[p].calls
+			<< ", \"wall_ms\": " << jsonNumber(phases[p].wallMs) << ", \"cpu_ms\": " << jsonNumber(phases[p].cpuMs) << "}";
+	}
+	off << "\n  },\n  \"counters\": {";
+	for (int k = 0; k < counters.size(); k++)
+	{
+		off << (k ? ",\n    \"" : "\n    \"") << counters[k].first << "\": " << jsonNumber(counters[k].second);
+	}
+	off << (counters.empty() ? "},\n" : "\n  },\n");
+	off << "  \"frames\": [";
+	for (int k = 0; k < frames.size(); k++)
+	{
+		const Frame& f = frames[k];
+		off << (k ? ",\n    " : "\n    ") << "{\"frame\": " << f.seq_id << ", \"iterations\": " << f.iterations << ", \"residual\": "
+			<< jsonNumber(f.residual) << ", \"converged\": " << (f.converged ? "true" : "false") << ", \"wall_ms\": " << jsonNumber(f.wallMs) << "}";
+	}
+	off << (frames.empty() ? "]\n" : "\n  ]\n");
+	off << "}\n";
+	if (!off.good())
+	{
+		std::cerr << "Error: could not write profile " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ARAPProfile::writeCSV(const std::string& filename) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ostringstream header, row;
+	row.precision(17);
+	for (int p = 0; p < ARAP_PHASE_COUNT; p++)
+	{
+		header << (p ? "," : "") << phaseName((ARAPPhase)p) << "_wall_ms," << phaseName((ARAPPhase)p) << "_cpu_ms";
+		row << (p ? "," : "") << phases[p].wallMs << "," << phases[p].cpuMs;
+	}
+	// the same columns for every run, so that runs of different solvers share one file;
+	// a counter this run did not set is left empty
+	for (const char* name : csvCounters)
+	{
+		header << "," << name;
+		row << ",";
+		for (const auto& c : counters)
+		{
+			if (c.first == name) row << c.second;
+		}
+	}
+	// rows are only appended under the same columns
+	std::string existing;
+	{
+		std::ifstream iff(filename.c_str());
+		std::getline(iff, existing);
+	}
+	if (!existing.empty() && existing != header.str())
+	{
+		std::cerr << "Error: " << filename << " has other columns than this version's profile!" << std::endl;
+		return false;
+	}
+	std::ofstream off(filename.c_str(), std::ios::app);
+	if (existing.empty()) off << header.str() << "\n";
+	off << row.str() << "\n";
+	if (!off.good())
+	{
+		std::cerr << "Error: could not write profile " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+ARAPPhaseTimer::ARAPPhaseTimer(ARAPProfile* profile, ARAPPhase phase) :profile(profile), phase(phase), threadCpu(phase == ARAP_PHASE_WRITE)
+{
+	if (!profile) return;
+	wall0 = wallMs();
+	cpu0 = threadCpu ? threadCpuMs() : processCpuMs();
+}
+
+void ARAPPhaseTimer::stop()
+{
+	if (!profile) return;
+	const double cpu = (threadCpu ? threadCpuMs() : processCpuMs()) - cpu0;
+	profile->add(phase, wallMs() - wall0, cpu);
+	profile = nullptr;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+enum ARAPPhase
+{
+	ARAP_PHASE_LOAD,  // mesh and handle file reading
+	ARAP_PHASE_WEIGHTS,  // adjacency and cotangent weights (ARAPDeform constructor)
+	ARAP_PHASE_TRIPLETS,  // triplets of A
+	ARAP_PHASE_FACTORIZE,  // A^T*A and its factor, or the matrix-free setup
+	ARAP_PHASE_RHS,  // right-hand side of the global step
+	ARAP_PHASE_SOLVE,  // global step
+	ARAP_PHASE_LOCAL,  // local step
+	ARAP_PHASE_WRITE,  // frame output, on the writer's I/O thread
+	ARAP_PHASE_COUNT
+};
+
+// "load", "weights", "triplets", "factorize", "rhs", "solve", "local", "write"
+const char* phaseName(ARAPPhase phase);
+
+// Timings and counters of one volumeARAP run. Every phase accumulates wall time
+// and CPU time; CPU time is that of the whole process (so parallel phases show
+// their thread usage as cpu / wall), except for the write phase, which runs next
+// to the solver on the I/O thread and takes that thread's own CPU time. Counters
+// are named values (nnz, iterations, ...) in the order they were first set.
+// Every member may be called from several jobs at once.
+//
+// write() stores a JSON object with the phases, counters and per-frame records,
+// or, for a .csv file name, appends one row of phase times and counters (with a
+// header line when the file is new), so runs over cages of different sizes and
+// solvers can be collected into one table. CSV rows have a fixed column per known
+// counter, empty where the run did not set it.
+class ARAPProfile
+{
+public:
+	struct Phase
+	{
+		long long calls = 0;
+		double wallMs = 0;
+		double cpuMs = 0;
+	};
+	struct Frame
+	{
+		int seq_id;
+		int iterations;
+		double residual;
+		bool converged;
+		double wallMs;
+	};
+
+	void add(ARAPPhase phase, double wallMs, double cpuMs);
+	void set(const std::string& counter, double value);
+	void increment(const std::string& counter, double value = 1);
+	// one frame of a sequence, as reported by the solver (frames, converged_frames, max_residual)
+	void addFrame(int seq_id, int iterations, double residual, bool converged, double wallMs);
+
+	Phase phase(ARAPPhase phase) const;
+	double counter(const std::string& counter) const;  // 0 if never set
+	// one line per phase with calls, wall and cpu ms, then the counters
+	std::string summary() const;
+	bool write(const std::string& filename) const;
+
+private:
+	double& slot(const std::string& counter);
+	bool writeJSON(const std::string& filename) const;
+	bool writeCSV(const std::string& filename) const;
+
+	mutable std::mutex mutex;
+	Phase phases[ARAP_PHASE_COUNT];
+	std::vector<std::pair<std::string, double>> counters;
+	std::vector<Frame> frames;
+};
+
+// Adds the wall and CPU time from construction to stop() (or destruction) to a
+// phase of profile; does nothing without a profile.
+class ARAPPhaseTimer
+{
+public:
+	ARAPPhaseTimer(ARAPProfile* profile, ARAPPhase phase);
+	~ARAPPhaseTimer() { this->stop(); }
+	ARAPPhaseTimer(const ARAPPhaseTimer&) = delete;
+	ARAPPhaseTimer& operator=(const ARAPPhaseTimer&) = delete;
+	void stop();
+
+private:
+	ARAPProfile* profile;
+	ARAPPhase phase;
+	bool threadCpu;
+	double wall0 = 0;
+	double cpu0 = 0;
+};
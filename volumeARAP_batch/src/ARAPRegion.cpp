@@ -0,0 +1,173 @@
+#include "ARAPRegion.h"
+#include <algorithm>
+#include <chrono>
+
+ARAPRegion::ARAPRegion(ARAPDeform& full, int rings, double radius) :full(full), rings(rings), radius(radius)
+{
+	const int n_vertices = (int)full.mesh->n_vertices();
+	positions.resize(n_vertices);
+	for (int i = 0; i < n_vertices; i++) positions[i] = OVtoE(full.mesh->vertex(VertexHandle(i)));
+}
+
+void ARAPRegion::grow()
+{
+	const ARAPAdjacency& adj = full.adjacency;
+	const int n_vertices = adj.n_vertices();
+	std::vector<int> depth(n_vertices, -1), source(n_vertices, -1), queue;
+	for (int i = 0; i < (int)full.controlpoint_number.size(); i++)
+	{
+		const Eigen::Vector4i& tet = full.bary_vert_index[full.controlpoint_number[i].first];
+		for (int m = 0; m < 4; m++)
+		{
+			if (depth[tet[m]] >= 0) continue;
+			depth[tet[m]] = 0;
+			source[tet[m]] = tet[m];
+			queue.push_back(tet[m]);
+		}
+	}
+	// multi-source BFS; in radius mode a vertex is kept while it is close enough to
+	// the control vertex its path started from
+	for (int head = 0; head < (int)queue.size(); head++)
+	{
+		const int v = queue[head];
+		if (radius <= 0 && depth[v] >= rings) continue;
+		const Tet_vec3d& s = full.mesh->vertex(VertexHandle(source[v]));
+		for (int e = adj.offsets[v]; e < adj.offsets[v + 1]; e++)
+		{
+			const int u = adj.neighbors[e];
+			if (depth[u] >= 0) continue;
+			if (radius > 0 && (full.mesh->vertex(VertexHandle(u)) - s).norm() > radius) continue;
+			depth[u] = depth[v] + 1;
+			source[u] = source[v];
+			queue.push_back(u);
+		}
+	}
+	std::sort(queue.begin(), queue.end());
+	n_region = (int)queue.size();
+
+	// the pinned ring: outside the region, next to it
+	std::vector<int> ring;
+	for (int v : queue)
+	{
+		for (int e = adj.offsets[v]; e < adj.offsets[v + 1]; e++)
+		{
+			const int u = adj.neighbors[e];
+			if (depth[u] >= 0) continue;
+			depth[u] = -2;
+			ring.push_back(u);
+		}
+	}
+	std::sort(ring.begin(), ring.end());
+	vertices = queue;
+	vertices.insert(vertices.end(), ring.begin(), ring.end());
+}
+
+bool ARAPRegion::prefactor()
+{
+	auto t0 = std::chrono::steady_clock::now();
+	this->grow();
+	const ARAPAdjacency& adj = full.adjacency;
+	std::vector<int> local(adj.n_vertices(), -1);
+	for (int s = 0; s < (int)vertices.size(); s++) local[vertices[s]] = s;
+
+	// the full mesh's adjacency and weights restricted to the sub-mesh
+	mesh.clear(false);
+	ARAPAdjacency sub;
+	sub.offsets.push_back(0);
+	for (int v : vertices)
+	{
+		mesh.add_vertex(full.mesh->vertex(VertexHandle(v)));
+		for (int e = adj.offsets[v]; e < adj.offsets[v + 1]; e++)
+		{
+			if (local[adj.neighbors[e]] < 0) continue;
+			sub.neighbors.push_back(local[adj.neighbors[e]]);
+			sub.rest_edges.push_back(adj.rest_edges[e]);
+			sub.weights.push_back(adj.weights[e]);
+		}
+		sub.offsets.push_back((int)sub.neighbors.size());
+	}
+
+	arap.reset(new ARAPDeform(mesh, sub, full.hardConstrain));
+	arap->maxIterTime = full.maxIterTime;
+	arap->tolerance = full.tolerance;
+	arap->convergence = full.convergence;
+	arap->andersonWindow = full.andersonWindow;
+	arap->warmStart = full.warmStart;
+	arap->bbox_diagonal = full.bbox_diagonal;
+	arap->separateAxes = full.separateAxes;
+	arap->solver.backendType = full.solver.backendType;
+	arap->solver.pcg = full.solver.pcg;
+	arap->solver.refinementSteps = full.solver.refinementSteps;
+	arap->matrixFree = full.matrixFree;
+	arap->matrixFreeSolver.options = full.matrixFreeSolver.options;
+	arap->mixedPrecision = full.mixedPrecision;
+	arap->rotationKernel = full.rotationKernel;
+	arap->profile = full.profile;
+	std::vector<Eigen::Vector4i> tets(full.controlpoint_number.size());
+	std::vector<Eigen::Vector4d> barys(full.controlpoint_number.size());
+	for (int i = 0; i < (int)full.controlpoint_number.size(); i++)
+	{
+		const Eigen::Vector4i& tet = full.bary_vert_index[full.controlpoint_number[i].first];
+		for (int m = 0; m < 4; m++) tets[i][m] = local[tet[m]];
+		barys[i] = full.barycentric[i];
+	}
+	arap->set_controls(tets, barys);
+	for (int s = n_region; s < (int)vertices.size(); s++) arap->pinned.push_back(s);
+	bool ok = arap->prefactor();
+	std::cout << "region: " << n_region << " of " << adj.n_vertices() << " vertices, " << vertices.size() - n_region << " pinned, "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() << " ms" << std::endl;
+	return ok;
+}
+
+void ARAPRegion::init_state(ARAPState& state) const
+{
+	arap->init_state(state);
+	std::vector<Eigen::Vector3d> current(vertices.size());
+	for (int s = 0; s < (int)vertices.size(); s++) current[s] = positions[vertices[s]];
+	arap->set_positions(state, current);
+}
+
+ARAPFrameReport ARAPRegion::deform_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPState& state)
+{
+	// without warm start, restart from the current positions rather than the rest pose,
+	// which is where the pinned ring is held
+	if (!arap->warmStart)
+	{
+		this->init_state(state);
+	}
+	ARAPFrameReport report = arap->iterate_frame(frameConstPoint, state, arap->maxIterTime);
+	for (int s = 0; s < n_region; s++) positions[vertices[s]] = state.positions[s];
+	return report;
+}
+
+bool ARAPRegion::yyj_ARAPDeform(std::string& handlefile, std::string outputFolder)
+{
+	ARAPHandleFile handles;
+	ARAPPhaseTimer loadTimer(full.profile, ARAP_PHASE_LOAD);
+	if (!handles.open(handlefile) || !handles.checkVertices((int)full.mesh->n_vertices()))
+	{
+		return false;
+	}
+	loadTimer.stop();
+	full.set_controls(handles.bary_vert_index, handles.barycentric);
+	if (!this->prefactor())
+	{
+		return false;
+	}
+	ARAPState state;
+	this->init_state(state);
+
+	ARAPFrameWriter writer(*full.mesh, outputFolder, full.outputFormat, full.profile);
+	std::vector<Eigen::Vector3d> frameBuffer;
+	for (int seq_id = 0; seq_id < handles.frames(); seq_id++) {
+		std::cout << "processing the " << seq_id << " deformation" << std::endl;
+		auto t0 = std::chrono::steady_clock::now();
+		ARAPFrameReport report = this->deform_frame(handles.frame(seq_id, frameBuffer), state);
+		const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		full.record_frame(seq_id, report, ms);
+		std::cout << "Frame Time:" << ms << "ms" << std::endl;
+		std::cout << arapFrameSummary(seq_id, report) << std::endl;
+		writer.write(seq_id, positions);
+	}
+	return writer.finish();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ARAPDeform.h"
+#include <memory>
+
+// Region-of-interest ARAP. The region is grown by a BFS over the cached adjacency
+// of the full mesh from the vertices of the control tets: k rings of it, or every
+// vertex within a rest-pose radius of the control vertex it was reached from. The
+// ring of vertices just outside is pinned at the full mesh's current positions,
+// and only the region (plus that ring) is assembled, factorized and solved, so the
+// cost of an edit follows the size of the region, not of the mesh. Edge weights
+// are those of the full mesh; pinned vertices only see their edges into the
+// sub-mesh when their rotations are fitted.
+class ARAPRegion
+{
+public:
+	ARAPDeform& full;
+	int rings;
+	double radius;  // > 0: grow by rest-pose distance instead of rings
+	// sub-mesh vertex -> full mesh vertex: the region first, then the pinned ring
+	std::vector<int> vertices;
+	int n_region = 0;
+	TetrahedralMesh mesh;  // vertices only, at their rest positions
+	std::unique_ptr<ARAPDeform> arap;
+	std::vector<Eigen::Vector3d> positions;  // current positions of the full mesh
+
+	ARAPRegion(ARAPDeform& full, int rings, double radius = 0);
+	// grow the region around the controls of full, build and factorize its system
+	bool prefactor();
+	void init_state(ARAPState& state) const;
+	// solve one frame on the region and write the result into positions
+	ARAPFrameReport deform_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPState& state);
+	// same as ARAPDeform::yyj_ARAPDeform, solving every frame on the region only
+	bool yyj_ARAPDeform(std::string& handlefile, std::string outputFolder);
+
+private:
+	void grow();
+};
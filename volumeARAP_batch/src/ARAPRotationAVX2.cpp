@@ -0,0 +1,46 @@
+// built with -mavx2 -mfma (/arch:AVX2), see CMakeLists.txt
+#include "ARAPRotationSIMD.h"
+#include <immintrin.h>
+
+namespace {
+
+struct PackAVX2
+{
+	static const int W = 4;
+	typedef __m256d Mask;
+	__m256d v;
+
+	PackAVX2() {}
+	PackAVX2(__m256d v) :v(v) {}
+	static PackAVX2 zero() { return _mm256_setzero_pd(); }
+	static PackAVX2 set1(double x) { return _mm256_set1_pd(x); }
+	// the unmasked gather leaves its source register undefined, which -Wall reports as uninitialized
+	static PackAVX2 gather(const double* base, const int* index)
+	{
+		return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, _mm_loadu_si128((const __m128i*)index), _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+	}
+	static PackAVX2 fmadd(PackAVX2 a, PackAVX2 b, PackAVX2 c) { return _mm256_fmadd_pd(a.v, b.v, c.v); }
+	static PackAVX2 sqrt(PackAVX2 a) { return _mm256_sqrt_pd(a.v); }
+	static PackAVX2 abs(PackAVX2 a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+	static Mask greater(PackAVX2 a, PackAVX2 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+	static PackAVX2 select(Mask m, PackAVX2 a, PackAVX2 b) { return _mm256_blendv_pd(b.v, a.v, m); }
+	static bool any(Mask m) { return _mm256_movemask_pd(m) != 0; }
+	static void storeMask(Mask m, unsigned char* out)
+	{
+		const int bits = _mm256_movemask_pd(m);
+		for (int l = 0; l < W; l++) out[l] = (bits >> l) & 1;
+	}
+	void store(double* out) const { _mm256_storeu_pd(out, v); }
+};
+
+inline PackAVX2 operator+(PackAVX2 a, PackAVX2 b) { return _mm256_add_pd(a.v, b.v); }
+inline PackAVX2 operator-(PackAVX2 a, PackAVX2 b) { return _mm256_sub_pd(a.v, b.v); }
+inline PackAVX2 operator*(PackAVX2 a, PackAVX2 b) { return _mm256_mul_pd(a.v, b.v); }
+inline PackAVX2 operator/(PackAVX2 a, PackAVX2 b) { return _mm256_div_pd(a.v, b.v); }
+
+}
+
+void fitRotationsAVX2(const ARAPRotationBatch& batch, int begin, int end)
+{
+	fitRotationRange<PackAVX2>(batch, begin, end);
+}
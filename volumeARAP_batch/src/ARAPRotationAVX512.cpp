@@ -0,0 +1,45 @@
+// built with -mavx512f (/arch:AVX512), see CMakeLists.txt
+#include "ARAPRotationSIMD.h"
+#include <immintrin.h>
+
+namespace {
+
+struct PackAVX512
+{
+	static const int W = 8;
+	typedef __mmask8 Mask;
+	__m512d v;
+
+	PackAVX512() {}
+	PackAVX512(__m512d v) :v(v) {}
+	static PackAVX512 zero() { return _mm512_setzero_pd(); }
+	static PackAVX512 set1(double x) { return _mm512_set1_pd(x); }
+	// the unmasked gather leaves its source register undefined, which -Wall reports as uninitialized
+	static PackAVX512 gather(const double* base, const int* index)
+	{
+		return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), (__mmask8)0xFF, _mm256_loadu_si256((const __m256i*)index), base, 8);
+	}
+	static PackAVX512 fmadd(PackAVX512 a, PackAVX512 b, PackAVX512 c) { return _mm512_fmadd_pd(a.v, b.v, c.v); }
+	static PackAVX512 sqrt(PackAVX512 a) { return _mm512_mask_sqrt_pd(_mm512_setzero_pd(), (__mmask8)0xFF, a.v); }  // masked like gather
+	static PackAVX512 abs(PackAVX512 a) { return _mm512_abs_pd(a.v); }
+	static Mask greater(PackAVX512 a, PackAVX512 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+	static PackAVX512 select(Mask m, PackAVX512 a, PackAVX512 b) { return _mm512_mask_blend_pd(m, b.v, a.v); }
+	static bool any(Mask m) { return m != 0; }
+	static void storeMask(Mask m, unsigned char* out)
+	{
+		for (int l = 0; l < W; l++) out[l] = (m >> l) & 1;
+	}
+	void store(double* out) const { _mm512_storeu_pd(out, v); }
+};
+
+inline PackAVX512 operator+(PackAVX512 a, PackAVX512 b) { return _mm512_add_pd(a.v, b.v); }
+inline PackAVX512 operator-(PackAVX512 a, PackAVX512 b) { return _mm512_sub_pd(a.v, b.v); }
+inline PackAVX512 operator*(PackAVX512 a, PackAVX512 b) { return _mm512_mul_pd(a.v, b.v); }
+inline PackAVX512 operator/(PackAVX512 a, PackAVX512 b) { return _mm512_div_pd(a.v, b.v); }
+
+}
+
+void fitRotationsAVX512(const ARAPRotationBatch& batch, int begin, int end)
+{
+	fitRotationRange<PackAVX512>(batch, begin, end);
+}
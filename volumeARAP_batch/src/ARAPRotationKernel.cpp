@@ -0,0 +1,132 @@
+#include "ARAPRotationKernel.h"
+#include "ARAPDeform.h"
+#include "ARAPRotationSIMD.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+bool cpuSupports(ARAPRotationKernel kernel)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	switch (kernel)
+	{
+	case ARAP_ROTATION_SCALAR: return true;
+	case ARAP_ROTATION_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	case ARAP_ROTATION_AVX512: return __builtin_cpu_supports("avx512f");
+	}
+	return false;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	if (kernel == ARAP_ROTATION_SCALAR) return true;
+	int info[4];
+	__cpuid(info, 1);
+	const bool fma = (info[2] & (1 << 12)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!osxsave) return false;
+	// the OS must save the AVX (and for AVX-512 the opmask and upper ZMM) state
+	const unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	if (kernel == ARAP_ROTATION_AVX2) return fma && (info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6;
+	return (info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6;
+#else
+	return kernel == ARAP_ROTATION_SCALAR;
+#endif
+}
+
+}
+
+const char* rotationKernelName(ARAPRotationKernel kernel)
+{
+	switch (kernel)
+	{
+	case ARAP_ROTATION_SCALAR: return "scalar";
+	case ARAP_ROTATION_AVX2: return "avx2";
+	case ARAP_ROTATION_AVX512: return "avx512";
+	}
+	return "unknown";
+}
+
+bool rotationKernelFromName(const std::string& name, ARAPRotationKernel& kernel)
+{
+	for (ARAPRotationKernel k : { ARAP_ROTATION_SCALAR, ARAP_ROTATION_AVX2, ARAP_ROTATION_AVX512 })
+	{
+		if (name == rotationKernelName(k))
+		{
+			kernel = k;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool rotationKernelAvailable(ARAPRotationKernel kernel)
+{
+	switch (kernel)
+	{
+	case ARAP_ROTATION_SCALAR: return true;
+	case ARAP_ROTATION_AVX2:
+#ifdef ARAP_WITH_AVX2
+		return cpuSupports(kernel);
+#else
+		return false;
+#endif
+	case ARAP_ROTATION_AVX512:
+#ifdef ARAP_WITH_AVX512
+		return cpuSupports(kernel);
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+std::vector<ARAPRotationKernel> availableRotationKernels()
+{
+	std::vector<ARAPRotationKernel> kernels;
+	for (ARAPRotationKernel k : { ARAP_ROTATION_SCALAR, ARAP_ROTATION_AVX2, ARAP_ROTATION_AVX512 })
+	{
+		if (rotationKernelAvailable(k)) kernels.push_back(k);
+	}
+	return kernels;
+}
+
+ARAPRotationKernel detectRotationKernel()
+{
+	// checked once, the CPU does not change under a running process
+	static const ARAPRotationKernel best = availableRotationKernels().back();
+	return best;
+}
+
+void fitRotations(ARAPRotationKernel kernel, const ARAPAdjacency& adjacency, const std::vector<Eigen::Vector3d>& positions, std::vector<Eigen::Matrix3d>& R)
+{
+	const int n_vertices = adjacency.n_vertices();
+	void (*simd)(const ARAPRotationBatch&, int, int) = nullptr;
+#ifdef ARAP_WITH_AVX2
+	if (kernel == ARAP_ROTATION_AVX2 && rotationKernelAvailable(kernel)) simd = fitRotationsAVX2;
+#endif
+#ifdef ARAP_WITH_AVX512
+	if (kernel == ARAP_ROTATION_AVX512 && rotationKernelAvailable(kernel)) simd = fitRotationsAVX512;
+#endif
+	std::vector<unsigned char> degenerate(simd ? n_vertices : 0);
+	ARAPRotationBatch batch = { adjacency.offsets.data(), adjacency.neighbors.data(), (const double*)adjacency.rest_edges.data(),
+		(const double*)positions.data(), (double*)R.data(), degenerate.data() };
+	const int blockSize = 256;  // a multiple of every lane count
+	const int n_blocks = (n_vertices + blockSize - 1) / blockSize;
+#pragma omp parallel for schedule(static)
+	for (int b = 0; b < n_blocks; b++)
+	{
+		const int begin = b * blockSize, end = std::min(n_vertices, begin + blockSize);
+		if (simd) simd(batch, begin, end);
+		for (int i = begin; i < end; i++)
+		{
+			if (simd && !degenerate[i]) continue;
+			Eigen::Matrix3d edgeMatrixSum = Eigen::Matrix3d::Zero();
+			for (int edgeCounter = adjacency.offsets[i]; edgeCounter < adjacency.offsets[i + 1]; edgeCounter++)
+			{
+				edgeMatrixSum.noalias() += adjacency.rest_edges[edgeCounter] * (positions[i] - positions[adjacency.neighbors[edgeCounter]]).transpose();
+			}
+			R[i] = fitRotation(edgeMatrixSum);
+		}
+	}
+}
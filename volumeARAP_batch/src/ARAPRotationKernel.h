@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+
+struct ARAPAdjacency;
+
+enum ARAPRotationKernel
+{
+	ARAP_ROTATION_SCALAR,  // one vertex at a time, fitRotation()
+	ARAP_ROTATION_AVX2,  // 4 vertices per AVX2 lane group (ARAP_WITH_AVX2 builds, AVX2 + FMA CPUs)
+	ARAP_ROTATION_AVX512  // 8 vertices per AVX-512 lane group (ARAP_WITH_AVX512 builds, AVX-512F CPUs)
+};
+
+// "scalar", "avx2", "avx512"
+const char* rotationKernelName(ARAPRotationKernel kernel);
+bool rotationKernelFromName(const std::string& name, ARAPRotationKernel& kernel);
+// compiled in and supported by the CPU this runs on
+bool rotationKernelAvailable(ARAPRotationKernel kernel);
+std::vector<ARAPRotationKernel> availableRotationKernels();
+// the widest available kernel
+ARAPRotationKernel detectRotationKernel();
+
+// The local step: R[i] is the rotation fitted to the rest and deformed edges of
+// vertex i. The SIMD kernels accumulate the covariances of 4 or 8 vertices side by
+// side and diagonalize S^T*S with Jacobi sweeps; vertices whose covariance has rank
+// < 2 go through fitRotation() like in the scalar kernel. An unavailable kernel
+// runs as ARAP_ROTATION_SCALAR.
+void fitRotations(ARAPRotationKernel kernel, const ARAPAdjacency& adjacency, const std::vector<Eigen::Vector3d>& positions, std::vector<Eigen::Matrix3d>& R);
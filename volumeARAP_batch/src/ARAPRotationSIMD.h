@@ -0,0 +1,196 @@
+#pragma once
+
+// Structure-of-arrays local step kernel shared by the per-ISA translation units
+// (ARAPRotationAVX2.cpp, ARAPRotationAVX512.cpp), which are the only files built
+// with -mavx2 / -mavx512f. Nothing here may pull in Eigen or the standard library:
+// an inline function instantiated under those flags could otherwise be picked by
+// the linker for the rest of the program.
+
+// raw CSR adjacency and buffers of one local step, see ARAPAdjacency
+struct ARAPRotationBatch
+{
+	const int* offsets;
+	const int* neighbors;
+	const double* rest_edges;  // xyz per half-edge
+	const double* positions;  // xyz per vertex
+	double* R;  // column-major 3x3 per vertex
+	unsigned char* degenerate;  // per vertex: 1 where R was not written (rank < 2)
+};
+
+// rotations of vertices [begin, end); only defined when the build has the ISA
+void fitRotationsAVX2(const ARAPRotationBatch& batch, int begin, int end);
+void fitRotationsAVX512(const ARAPRotationBatch& batch, int begin, int end);
+
+namespace {
+
+// Pack is W doubles with the usual arithmetic; Pack::Mask its comparison result.
+// Vertices v0 .. v0 + W - 1 go one per lane: their covariances are accumulated
+// neighbour by neighbour with gathers (a lane past its degree gathers its own
+// position, which adds zero), then S^T*S is diagonalized by cyclic Jacobi sweeps
+// and R is built from the eigenvectors as in fitRotation().
+template <typename Pack>
+inline void fitRotationGroup(const ARAPRotationBatch& batch, int v0, int n)
+{
+	const int W = Pack::W;
+	typedef typename Pack::Mask Mask;
+	int vertex[W], first[W], count[W];
+	int maxCount = 0;
+	for (int l = 0; l < W; l++)
+	{
+		vertex[l] = v0 + (l < n ? l : n - 1);
+		first[l] = batch.offsets[vertex[l]];
+		count[l] = batch.offsets[vertex[l] + 1] - first[l];
+		if (count[l] > maxCount) maxCount = count[l];
+	}
+
+	int pIndex[W], qIndex[W], eIndex[W];
+	for (int l = 0; l < W; l++) pIndex[l] = vertex[l] * 3;
+	const Pack px = Pack::gather(batch.positions, pIndex);
+	const Pack py = Pack::gather(batch.positions + 1, pIndex);
+	const Pack pz = Pack::gather(batch.positions + 2, pIndex);
+	// S = sum rest_edge * deformed_edge^T, row-major
+	Pack S[9];
+	for (int k = 0; k < 9; k++) S[k] = Pack::zero();
+	for (int k = 0; k < maxCount; k++)
+	{
+		for (int l = 0; l < W; l++)
+		{
+			const bool active = k < count[l];
+			qIndex[l] = active ? batch.neighbors[first[l] + k] * 3 : pIndex[l];
+			eIndex[l] = active ? (first[l] + k) * 3 : 0;
+		}
+		const Pack dx = px - Pack::gather(batch.positions, qIndex);
+		const Pack dy = py - Pack::gather(batch.positions + 1, qIndex);
+		const Pack dz = pz - Pack::gather(batch.positions + 2, qIndex);
+		for (int r = 0; r < 3; r++)
+		{
+			const Pack e = Pack::gather(batch.rest_edges + r, eIndex);
+			S[r * 3] = Pack::fmadd(e, dx, S[r * 3]);
+			S[r * 3 + 1] = Pack::fmadd(e, dy, S[r * 3 + 1]);
+			S[r * 3 + 2] = Pack::fmadd(e, dz, S[r * 3 + 2]);
+		}
+	}
+
+	// A = S^T*S, symmetric
+	Pack a[3][3];
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = i; j < 3; j++)
+		{
+			a[i][j] = S[i] * S[j] + S[3 + i] * S[3 + j] + S[6 + i] * S[6 + j];
+			a[j][i] = a[i][j];
+		}
+	}
+	Pack V[3][3];
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++) V[i][j] = i == j ? Pack::set1(1) : Pack::zero();
+	}
+	const Pack zero = Pack::zero(), one = Pack::set1(1), half = Pack::set1(0.5);
+	for (int sweep = 0; sweep < 12; sweep++)
+	{
+		const Pack off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		const Pack diag = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+		if (!Pack::any(Pack::greater(off, Pack::set1(1e-32) * diag))) break;
+		static const int pairs[3][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 2, 0 } };
+		for (int k = 0; k < 3; k++)
+		{
+			const int p = pairs[k][0], q = pairs[k][1], r = pairs[k][2];
+			// Jacobi rotation zeroing a[p][q]; t = 0 where it already is
+			const Mask rotate = Pack::greater(Pack::abs(a[p][q]), zero);
+			const Pack apq = Pack::select(rotate, a[p][q], one);
+			const Pack tau = (a[q][q] - a[p][p]) * half / apq;
+			Pack t = one / (Pack::abs(tau) + Pack::sqrt(Pack::fmadd(tau, tau, one)));
+			t = Pack::select(Pack::greater(zero, tau), zero - t, t);
+			t = Pack::select(rotate, t, zero);
+			const Pack c = one / Pack::sqrt(Pack::fmadd(t, t, one));
+			const Pack s = t * c;
+			const Pack tpq = t * a[p][q];
+			a[p][p] = a[p][p] - tpq;
+			a[q][q] = a[q][q] + tpq;
+			a[p][q] = a[q][p] = zero;
+			const Pack apr = a[p][r], aqr = a[q][r];
+			a[p][r] = a[r][p] = c * apr - s * aqr;
+			a[q][r] = a[r][q] = s * apr + c * aqr;
+			for (int i = 0; i < 3; i++)
+			{
+				const Pack vp = V[i][p], vq = V[i][q];
+				V[i][p] = c * vp - s * vq;
+				V[i][q] = s * vp + c * vq;
+			}
+		}
+	}
+
+	// eigenvalues descending, eigenvectors (columns of V) with them
+	Pack d[3] = { a[0][0], a[1][1], a[2][2] };
+	static const int swaps[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+	for (int k = 0; k < 3; k++)
+	{
+		const int i = swaps[k][0], j = swaps[k][1];
+		const Mask m = Pack::greater(d[j], d[i]);
+		const Pack di = d[i];
+		d[i] = Pack::select(m, d[j], di);
+		d[j] = Pack::select(m, di, d[j]);
+		for (int row = 0; row < 3; row++)
+		{
+			const Pack vi = V[row][i];
+			V[row][i] = Pack::select(m, V[row][j], vi);
+			V[row][j] = Pack::select(m, vi, V[row][j]);
+		}
+	}
+	// the same rank test as fitRotation(); those lanes are left to its SVD fallback
+	const Mask wellPosed = Pack::greater(d[1], Pack::set1(1e-8) * d[0]);
+
+	// u1 = S v1 / |S v1|, u2 = S v2 orthogonalized against u1, u3 = u1 x u2
+	Pack u[3][3];
+	for (int k = 0; k < 2; k++)
+	{
+		for (int r = 0; r < 3; r++) u[k][r] = S[r * 3] * V[0][k] + S[r * 3 + 1] * V[1][k] + S[r * 3 + 2] * V[2][k];
+	}
+	Pack inv = one / Pack::sqrt(u[0][0] * u[0][0] + u[0][1] * u[0][1] + u[0][2] * u[0][2]);
+	for (int r = 0; r < 3; r++) u[0][r] = u[0][r] * inv;
+	const Pack dot = u[0][0] * u[1][0] + u[0][1] * u[1][1] + u[0][2] * u[1][2];
+	for (int r = 0; r < 3; r++) u[1][r] = u[1][r] - dot * u[0][r];
+	inv = one / Pack::sqrt(u[1][0] * u[1][0] + u[1][1] * u[1][1] + u[1][2] * u[1][2]);
+	for (int r = 0; r < 3; r++) u[1][r] = u[1][r] * inv;
+	u[2][0] = u[0][1] * u[1][2] - u[0][2] * u[1][1];
+	u[2][1] = u[0][2] * u[1][0] - u[0][0] * u[1][2];
+	u[2][2] = u[0][0] * u[1][1] - u[0][1] * u[1][0];
+	// flip the smallest direction if V is a reflection, so that det(R) = +1
+	const Pack det = V[0][0] * (V[1][1] * V[2][2] - V[1][2] * V[2][1])
+		- V[0][1] * (V[1][0] * V[2][2] - V[1][2] * V[2][0])
+		+ V[0][2] * (V[1][0] * V[2][1] - V[1][1] * V[2][0]);
+	const Pack sign = Pack::select(Pack::greater(zero, det), zero - one, one);
+	for (int r = 0; r < 3; r++) V[r][2] = V[r][2] * sign;
+
+	// R = sum_k v_k u_k^T, column-major
+	double out[9][W];
+	for (int c = 0; c < 3; c++)
+	{
+		for (int r = 0; r < 3; r++)
+		{
+			(V[r][0] * u[0][c] + V[r][1] * u[1][c] + V[r][2] * u[2][c]).store(out[c * 3 + r]);
+		}
+	}
+	unsigned char ok[W];
+	Pack::storeMask(wellPosed, ok);
+	for (int l = 0; l < n; l++)
+	{
+		batch.degenerate[v0 + l] = !ok[l];
+		if (!ok[l]) continue;
+		double* R = batch.R + (v0 + l) * 9;
+		for (int k = 0; k < 9; k++) R[k] = out[k][l];
+	}
+}
+
+template <typename Pack>
+inline void fitRotationRange(const ARAPRotationBatch& batch, int begin, int end)
+{
+	for (int v0 = begin; v0 < end; v0 += Pack::W)
+	{
+		const int n = end - v0 < Pack::W ? end - v0 : Pack::W;
+		fitRotationGroup<Pack>(batch, v0, n);
+	}
+}
+
+}
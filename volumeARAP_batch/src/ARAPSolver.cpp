@@ -0,0 +1,264 @@
+#include "ARAPSolver.h"
+#include <algorithm>
+#include <iostream>
+
+bool ARAPSolver::factorize(int rowNum, int colNum, int rhsCols, const std::vector<Tri>& triplets, int controlRows, bool constrained)
+{
+	std::cout << "Construct sparse A" << std::endl;
+	sparseA.resize(rowNum, colNum);
+	sparseA.setFromTriplets(triplets.begin(), triplets.end());
+	std::cout << "Construct sparse AT" << std::endl;
+	freeColumns.clear();
+	if (fixedColumns.empty())
+	{
+		sparseAT = sparseA.transpose();
+		fixedA.resize(0, 0);
+	}
+	else
+	{
+		// split A into its free and fixed columns
+		std::vector<char> isFixed(colNum, 0);
+		for (int c : fixedColumns) isFixed[c] = 1;
+		std::vector<Tri> freeSelect, fixedSelect;
+		for (int c = 0; c < colNum; c++)
+		{
+			if (isFixed[c]) fixedSelect.push_back(Tri(c, (int)fixedSelect.size(), 1.0));
+			else
+			{
+				freeSelect.push_back(Tri(c, (int)freeColumns.size(), 1.0));
+				freeColumns.push_back(c);
+			}
+		}
+		Eigen::SparseMatrix<double> P(colNum, freeColumns.size());
+		P.setFromTriplets(freeSelect.begin(), freeSelect.end());
+		sparseAT = (sparseA * P).transpose();
+		P.resize(colNum, fixedSelect.size());
+		P.setFromTriplets(fixedSelect.begin(), fixedSelect.end());
+		fixedA = sparseA * P;
+		colNum = (int)freeColumns.size();
+	}
+	normalMatrix = sparseAT * sparseAT.transpose();
+
+	n_rhs = rhsCols;
+	n_stencilRows = rowNum - controlRows;
+	this->constrained = constrained && controlRows > 0;
+	controls.resize(controlRows);
+	controlInFactor.assign(controlRows, 1);
+	terms.clear();
+	for (int k = 0; k < controlRows; k++)
+	{
+		controls[k] = sparseAT.col(n_stencilRows + k);
+		if (this->constrained) terms.push_back({ controls[k], 0.0, k });
+	}
+	controlMatrixT = sparseAT.rightCols(controlRows);
+	controlMatrix = controlMatrixT.transpose();
+	lowRankT = controlMatrix;
+	lowRank = controlMatrixT;
+	if (!this->constrained)
+	{
+		lowRank.resize(colNum, 0);
+		lowRankT.resize(0, colNum);
+	}
+
+	factorized = false;
+	backend = makeLinearSolver(backendType, pcg);
+	if (!backend)
+	{
+		std::cerr << "Error: solver backend " << solverBackendName(backendType) << " is not available in this build!" << std::endl;
+		return false;
+	}
+	std::cout << "cholesky begin (" << backend->name() << ")" << std::endl;
+	if (!backend->analyze(normalMatrix))
+	{
+		std::cerr << "Error: symbolic analysis of A^T*A failed!" << std::endl;
+		return false;
+	}
+	return refactorize();
+}
+
+bool ARAPSolver::refactorize()
+{
+	factorized = backend && backend->factorize(normalMatrix);
+	if (!factorized)
+	{
+		std::cerr << "Error: cholesky factorization of A^T*A failed!" << std::endl;
+	}
+	else if (!terms.empty())
+	{
+		factorized = factorizeSchur();
+	}
+	return factorized;
+}
+
+bool ARAPSolver::factorizeSchur()
+{
+	// M = W^T * (A^T*A)^-1 * W + diag(e), a block of columns at a time so the dense
+	// intermediate stays at cols() x blockSize
+	const int n_terms = (int)terms.size();
+	const int blockSize = 64;
+	const int n_blocks = (n_terms + blockSize - 1) / blockSize;
+	capacitance.resize(n_terms, n_terms);
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < n_blocks; b++)
+	{
+		const int first = b * blockSize, n = std::min(blockSize, n_terms - first);
+		RowMatrixXd Z;
+		backend->solve(RowMatrixXd(lowRank.middleCols(first, n)), Z);
+		capacitance.middleCols(first, n) = lowRankT * Z;
+	}
+	for (int t = 0; t < n_terms; t++) capacitance(t, t) += terms[t].shift;
+	schur.compute(capacitance);
+	if (schur.info() != Eigen::Success)
+	{
+		std::cerr << "Error: factorization of the constraint Schur complement failed!" << std::endl;
+		return false;
+	}
+	std::cout << "constraint Schur complement: " << n_terms << " x " << n_terms << std::endl;
+	return true;
+}
+
+void ARAPSolver::solve(const RowMatrixXd& B, RowMatrixXd& ATb, RowMatrixXd& x) const
+{
+	if (fixedColumns.empty())
+	{
+		this->solveFree(B, ATb, x);
+		return;
+	}
+	// B - A_fixed * x_fixed, then the free unknowns
+	RowMatrixXd xFixed(fixedColumns.size(), n_rhs), xFree(freeColumns.size(), n_rhs);
+	for (int k = 0; k < fixedColumns.size(); k++) xFixed.row(k) = x.row(fixedColumns[k]);
+	for (int k = 0; k < freeColumns.size(); k++) xFree.row(k) = x.row(freeColumns[k]);
+	RowMatrixXd reduced = B;
+	reduced.noalias() -= fixedA * xFixed;
+	RowMatrixXd ATbFree;
+	this->solveFree(reduced, ATbFree, xFree);
+	for (int k = 0; k < freeColumns.size(); k++)
+	{
+		x.row(freeColumns[k]) = xFree.row(k);
+		ATb.row(freeColumns[k]) = ATbFree.row(k);
+	}
+}
+
+void ARAPSolver::solveNormal(const RowMatrixXd& b, RowMatrixXd& x) const
+{
+	backend->solve(b, x);
+	for (int step = 0; step < refinementSteps; step++)
+	{
+		RowMatrixXd r = b;
+		r.noalias() -= normalMatrix * x;
+		RowMatrixXd dx;
+		backend->solve(r, dx);
+		x += dx;
+	}
+}
+
+void ARAPSolver::solveFree(const RowMatrixXd& B, RowMatrixXd& ATb, RowMatrixXd& x) const
+{
+	ATb.noalias() = sparseAT.leftCols(n_stencilRows) * B.topRows(n_stencilRows);
+	if (!controls.empty()) ATb.noalias() += controlMatrixT * B.bottomRows(controls.size());
+	this->solveNormal(ATb, x);
+	if (!terms.empty())
+	{
+		// project x onto C x = d, d being the constraint rows of B, and apply the
+		// added/removed rows; ATb is free again
+		RowMatrixXd r = lowRankT * x;
+		for (int t = 0; t < terms.size(); t++)
+		{
+			if (terms[t].shift == 0) r.row(t) -= B.row(n_stencilRows + terms[t].control);
+		}
+		RowMatrixXd lambda = schur.solve(r);
+		ATb.noalias() = lowRank * lambda;
+		RowMatrixXd correction;
+		this->solveNormal(ATb, correction);
+		x -= correction;
+	}
+}
+
+bool ARAPSolver::addControlRow(const Eigen::SparseVector<double>& row)
+{
+	if (!factorized || !fixedColumns.empty()) return false;
+	const int k = (int)controls.size();
+	controls.push_back(row);
+	controlInFactor.push_back(0);
+	this->appendTerm({ row, constrained ? 0.0 : 1.0, k });
+	return this->finishEdit();
+}
+
+bool ARAPSolver::removeControlRow(int k)
+{
+	if (!factorized || !fixedColumns.empty() || k < 0 || k >= controls.size()) return false;
+	for (int t = (int)terms.size() - 1; t >= 0; t--)
+	{
+		if (terms[t].control == k) this->removeTerm(t);
+	}
+	// c c^T stays in the factor, so it is taken out again by a negative term
+	if (controlInFactor[k]) this->appendTerm({ controls[k], -1.0, -1 });
+	controls.erase(controls.begin() + k);
+	controlInFactor.erase(controlInFactor.begin() + k);
+	for (Term& term : terms)
+	{
+		if (term.control > k) term.control--;
+	}
+	return this->finishEdit();
+}
+
+int ARAPSolver::lowRankTerms() const
+{
+	int n = 0;
+	for (const Term& term : terms) n += term.shift != 0;
+	return n;
+}
+
+void ARAPSolver::appendTerm(const Term& term)
+{
+	const int m = (int)terms.size();
+	RowMatrixXd z;
+	backend->solve(RowMatrixXd(Eigen::VectorXd(term.column)), z);
+	Eigen::Map<const Eigen::VectorXd> zc(z.data(), z.rows());
+	capacitance.conservativeResize(m + 1, m + 1);
+	for (int t = 0; t < m; t++)
+	{
+		capacitance(t, m) = capacitance(m, t) = terms[t].column.dot(zc);
+	}
+	capacitance(m, m) = term.column.dot(zc) + term.shift;
+	terms.push_back(term);
+}
+
+void ARAPSolver::removeTerm(int t)
+{
+	const int m = (int)terms.size();
+	const int tail = m - t - 1;
+	capacitance.block(t, 0, tail, m) = capacitance.block(t + 1, 0, tail, m).eval();
+	capacitance.block(0, t, m, tail) = capacitance.block(0, t + 1, m, tail).eval();
+	capacitance.conservativeResize(m - 1, m - 1);
+	terms.erase(terms.begin() + t);
+}
+
+bool ARAPSolver::finishEdit()
+{
+	const int n = (int)sparseAT.rows();
+	std::vector<Tri> entries;
+	for (int k = 0; k < controls.size(); k++)
+	{
+		for (Eigen::SparseVector<double>::InnerIterator it(controls[k]); it; ++it) entries.push_back(Tri(it.index(), k, it.value()));
+	}
+	controlMatrixT.resize(n, controls.size());
+	controlMatrixT.setFromTriplets(entries.begin(), entries.end());
+	controlMatrix = controlMatrixT.transpose();
+	entries.clear();
+	for (int t = 0; t < terms.size(); t++)
+	{
+		for (Eigen::SparseVector<double>::InnerIterator it(terms[t].column); it; ++it) entries.push_back(Tri(it.index(), t, it.value()));
+	}
+	lowRank.resize(n, terms.size());
+	lowRank.setFromTriplets(entries.begin(), entries.end());
+	lowRankT = lowRank.transpose();
+	if (terms.empty()) return true;
+	schur.compute(capacitance);
+	factorized = schur.info() == Eigen::Success;
+	if (!factorized)
+	{
+		std::cerr << "Error: factorization of the control update failed!" << std::endl;
+	}
+	return factorized;
+}
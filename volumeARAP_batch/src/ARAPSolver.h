@@ -0,0 +1,121 @@
+#pragma once
+
+#include "ARAPSolverBackend.h"
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <memory>
+#include <vector>
+
+typedef Eigen::Triplet<double> Tri;
+
+// Persistent normal-equation solver for the ARAP global step.
+// A is assembled once from triplets, A^T*A is formed and factorized once
+// (symbolic analysis + numeric factor). Solves only read the factor, so one
+// ARAPSolver can serve several jobs at once, each of them filling its own
+// preallocated B, A^T*B and x buffers.
+//
+// B and x are row-major with rhsCols columns: with one column they are the
+// interleaved x/y/z vectors of the 3|V| system, with three columns (one per
+// axis, A acting on |V| scalar unknowns) their memory layout is exactly the
+// same, so callers fill B and read x the same way in both modes.
+//
+// The last controlRows rows of A are control rows C. With constrained they are
+// equality constraints C x = d instead of least-squares rows. A^T*A = L^T*L + C^T*C
+// is still the matrix that is factorized (the C^T*C term keeps it definite and
+// leaves the constrained solution unchanged); the constraints are enforced through
+// the small dense Schur complement S = C (A^T*A)^-1 C^T, factorized once:
+//   x0 = (A^T*A)^-1 A^T B,  x = x0 - (A^T*A)^-1 C^T S^-1 (C x0 - d)
+// so the sparse factor never grows with the number of constraints.
+//
+// Control rows can be added and removed after factorize() without touching the
+// sparse factor K of A^T*A: every change is a low-rank term, a column w of W
+// with a shift e (+1 for an added least-squares row, -1 for a row of K that was
+// removed, 0 for a constraint), and the solve above generalizes to
+//   M = W^T K^-1 W + diag(e),  x = x0 - K^-1 W M^-1 (W^T x0 - d)
+// with d zero on the non-constraint columns. An edit costs one sparse solve and
+// a dense refactorization of M.
+//
+// The sparse solve of A^T*A goes through the backend selected by backendType
+// (see ARAPSolverBackend.h); set it before factorize(). With ARAP_SOLVER_PCG the
+// x passed to solve() is the initial guess, so keeping the previous solution in
+// it warm-starts the iteration.
+//
+// With refinementSteps > 0 every solve of A^T*A is followed by that many steps of
+// iterative refinement, x += K^-1 (b - K x), which recovers the digits a factor of
+// an ill-conditioned K (or a float right-hand side) loses.
+//
+// Columns listed in fixedColumns (set before factorize()) are not unknowns: they
+// keep the values x holds on entry to solve(), their part of A*x moves to the
+// right-hand side and only the free columns are factorized. Control edits then
+// need a new factorize().
+class ARAPSolver
+{
+public:
+	Eigen::SparseMatrix<double> sparseA;
+	Eigen::SparseMatrix<double> sparseAT;
+	Eigen::SparseMatrix<double> normalMatrix;  // A^T * A, as factorized
+	Eigen::SparseMatrix<double> fixedA;  // the fixed columns of A; sparseAT and the rest only keep the free ones
+	ARAPSolverBackend backendType = ARAP_SOLVER_LDLT;
+	ARAPPCGOptions pcg;
+	std::vector<int> fixedColumns;
+	int refinementSteps = 0;
+	std::unique_ptr<ARAPLinearSolver> backend;
+	Eigen::SparseMatrix<double> controlMatrix;  // C, the current control rows
+	Eigen::SparseMatrix<double> controlMatrixT;
+	Eigen::SparseMatrix<double> lowRank;  // W
+	Eigen::SparseMatrix<double> lowRankT;
+	Eigen::MatrixXd capacitance;  // M = W^T (A^T*A)^-1 W + diag(e), S without edits
+	Eigen::LDLT<Eigen::MatrixXd> schur;
+
+	ARAPSolver() {};
+	// build A, A^T, A^T*A, then run symbolic analysis and numeric factorization
+	// (and the Schur complement of the last controlRows rows if constrained)
+	bool factorize(int rowNum, int colNum, int rhsCols, const std::vector<Tri>& triplets, int controlRows = 0, bool constrained = false);
+	// numeric refactorization of normalMatrix, reusing the symbolic analysis
+	bool refactorize();
+	// x = (A^T*A)^-1 * A^T * B, all right-hand side columns at once, corrected onto the
+	// constraints if there are any; ATb and x are caller-owned buffers of size cols() x rhsCols()
+	void solve(const RowMatrixXd& B, RowMatrixXd& ATb, RowMatrixXd& x) const;
+
+	// append a control row (the new last row of B) / remove the k-th one, as a low-rank term
+	bool addControlRow(const Eigen::SparseVector<double>& row);
+	bool removeControlRow(int k);
+
+	int rows() const { return n_stencilRows + (int)controls.size(); }
+	int cols() const { return (int)sparseA.cols(); }
+	int rhsCols() const { return n_rhs; }
+	int controlRows() const { return (int)controls.size(); }
+	// added and removed least-squares rows carried next to the factor
+	int lowRankTerms() const;
+	bool isConstrained() const { return constrained; }
+	bool isFactorized() const { return factorized; }
+	const char* backendName() const { return backend ? backend->name() : solverBackendName(backendType); }
+
+private:
+	struct Term
+	{
+		Eigen::SparseVector<double> column;  // w
+		double shift;  // e
+		int control;  // control row of a constraint or added row, -1 for a removed row of K
+	};
+
+	bool factorizeSchur();
+	// x = K^-1 b through the backend, refined refinementSteps times
+	void solveNormal(const RowMatrixXd& b, RowMatrixXd& x) const;
+	// solve() on the free columns
+	void solveFree(const RowMatrixXd& B, RowMatrixXd& ATb, RowMatrixXd& x) const;
+	// M grows by the row and column of w; terms are only appended by edits
+	void appendTerm(const Term& term);
+	void removeTerm(int t);
+	// rebuild C, W and the factor of M after an edit
+	bool finishEdit();
+
+	std::vector<Eigen::SparseVector<double>> controls;
+	std::vector<char> controlInFactor;  // c c^T is part of A^T*A
+	std::vector<Term> terms;
+	std::vector<int> freeColumns;
+	int n_stencilRows = 0;
+	int n_rhs = 1;
+	bool constrained = false;
+	bool factorized = false;
+};
@@ -0,0 +1,161 @@
+#include "ARAPSolverBackend.h"
+#include <Eigen/IterativeLinearSolvers>
+#include <mutex>
+#ifdef ARAP_WITH_METIS
+#include <Eigen/MetisSupport>
+#endif
+#ifdef ARAP_WITH_CHOLMOD
+#include <Eigen/CholmodSupport>
+#endif
+
+namespace {
+
+template <class Factor>
+class DirectSolver : public ARAPLinearSolver
+{
+public:
+	explicit DirectSolver(const char* label) :label(label) {}
+	bool analyze(const Eigen::SparseMatrix<double>& K) override
+	{
+		factor.analyzePattern(K);
+		return factor.info() == Eigen::Success;
+	}
+	bool factorize(const Eigen::SparseMatrix<double>& K) override
+	{
+		factor.factorize(K);
+		return factor.info() == Eigen::Success;
+	}
+	void solve(const RowMatrixXd& b, RowMatrixXd& x) const override
+	{
+		x = factor.solve(b);
+	}
+	const char* name() const override { return label; }
+
+private:
+	Factor factor;
+	const char* label;
+};
+
+#ifdef ARAP_WITH_CHOLMOD
+// CHOLMOD keeps its workspace in cholmod_common, so solves are serialized
+class CholmodSolver : public DirectSolver<Eigen::CholmodSupernodalLLT<Eigen::SparseMatrix<double>>>
+{
+public:
+	CholmodSolver() :DirectSolver("cholmod") {}
+	void solve(const RowMatrixXd& b, RowMatrixXd& x) const override
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		DirectSolver::solve(b, x);
+	}
+
+private:
+	mutable std::mutex mutex;
+};
+#endif
+
+// Conjugate gradient on K with an incomplete Cholesky preconditioner, starting from
+// the x passed in: inside the local/global loop that is the previous global solution.
+// The iteration is run through Eigen's internal conjugate_gradient so that solve()
+// keeps no per-call state and stays safe to call concurrently.
+class PCGSolver : public ARAPLinearSolver
+{
+public:
+	explicit PCGSolver(const ARAPPCGOptions& options) :options(options) {}
+	bool analyze(const Eigen::SparseMatrix<double>& K) override
+	{
+		preconditioner.analyzePattern(K);
+		return preconditioner.info() == Eigen::Success;
+	}
+	bool factorize(const Eigen::SparseMatrix<double>& K) override
+	{
+		// row-major copy: K is symmetric and row-major products run in parallel
+		matrix = K;
+		preconditioner.factorize(K);
+		return preconditioner.info() == Eigen::Success;
+	}
+	void solve(const RowMatrixXd& b, RowMatrixXd& x) const override
+	{
+		if (x.rows() != b.rows() || x.cols() != b.cols()) x.setZero(b.rows(), b.cols());
+		Eigen::VectorXd xc, bc;
+		for (int c = 0; c < b.cols(); c++)
+		{
+			xc = x.col(c);
+			bc = b.col(c);
+			Eigen::Index iterations = options.maxIterations;
+			double error = options.tolerance;
+			Eigen::internal::conjugate_gradient(matrix, bc, xc, preconditioner, iterations, error);
+			x.col(c) = xc;
+		}
+	}
+	const char* name() const override { return "pcg"; }
+
+private:
+	ARAPPCGOptions options;
+	Eigen::SparseMatrix<double, Eigen::RowMajor> matrix;
+	Eigen::IncompleteCholesky<double, Eigen::Lower, Eigen::AMDOrdering<int>> preconditioner;
+};
+
+}
+
+std::unique_ptr<ARAPLinearSolver> makeLinearSolver(ARAPSolverBackend backend, const ARAPPCGOptions& pcg)
+{
+	typedef Eigen::SparseMatrix<double> SpMat;
+	switch (backend)
+	{
+	case ARAP_SOLVER_LDLT:
+		return std::unique_ptr<ARAPLinearSolver>(new DirectSolver<Eigen::SimplicialLDLT<SpMat, Eigen::Lower, Eigen::AMDOrdering<int>>>("ldlt"));
+	case ARAP_SOLVER_LLT:
+		return std::unique_ptr<ARAPLinearSolver>(new DirectSolver<Eigen::SimplicialLLT<SpMat, Eigen::Lower, Eigen::AMDOrdering<int>>>("llt"));
+#ifdef ARAP_WITH_METIS
+	case ARAP_SOLVER_LDLT_METIS:
+		return std::unique_ptr<ARAPLinearSolver>(new DirectSolver<Eigen::SimplicialLDLT<SpMat, Eigen::Lower, Eigen::MetisOrdering<int>>>("ldlt-metis"));
+#endif
+#ifdef ARAP_WITH_CHOLMOD
+	case ARAP_SOLVER_CHOLMOD:
+		return std::unique_ptr<ARAPLinearSolver>(new CholmodSolver());
+#endif
+	case ARAP_SOLVER_PCG:
+		return std::unique_ptr<ARAPLinearSolver>(new PCGSolver(pcg));
+	default:
+		return nullptr;
+	}
+}
+
+const char* solverBackendName(ARAPSolverBackend backend)
+{
+	switch (backend)
+	{
+	case ARAP_SOLVER_LDLT: return "ldlt";
+	case ARAP_SOLVER_LLT: return "llt";
+	case ARAP_SOLVER_LDLT_METIS: return "ldlt-metis";
+	case ARAP_SOLVER_CHOLMOD: return "cholmod";
+	case ARAP_SOLVER_PCG: return "pcg";
+	}
+	return "unknown";
+}
+
+bool solverBackendFromName(const std::string& name, ARAPSolverBackend& backend)
+{
+	for (ARAPSolverBackend b : { ARAP_SOLVER_LDLT, ARAP_SOLVER_LLT, ARAP_SOLVER_LDLT_METIS, ARAP_SOLVER_CHOLMOD, ARAP_SOLVER_PCG })
+	{
+		if (name == solverBackendName(b))
+		{
+			backend = b;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<ARAPSolverBackend> availableSolverBackends()
+{
+	std::vector<ARAPSolverBackend> backends = { ARAP_SOLVER_LDLT, ARAP_SOLVER_LLT };
+#ifdef ARAP_WITH_METIS
+	backends.push_back(ARAP_SOLVER_LDLT_METIS);
+#endif
+#ifdef ARAP_WITH_CHOLMOD
+	backends.push_back(ARAP_SOLVER_CHOLMOD);
+#endif
+	backends.push_back(ARAP_SOLVER_PCG);
+	return backends;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Eigen/Sparse>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMatrixXd;
+
+enum ARAPSolverBackend
+{
+	ARAP_SOLVER_LDLT,  // Eigen::SimplicialLDLT, AMD ordering
+	ARAP_SOLVER_LLT,  // Eigen::SimplicialLLT, AMD ordering
+	ARAP_SOLVER_LDLT_METIS,  // Eigen::SimplicialLDLT, METIS nested dissection (ARAP_WITH_METIS builds)
+	ARAP_SOLVER_CHOLMOD,  // CHOLMOD supernodal LLT (ARAP_WITH_CHOLMOD builds)
+	ARAP_SOLVER_PCG  // conjugate gradient with an incomplete Cholesky preconditioner, warm-started
+};
+
+// stopping rule of ARAP_SOLVER_PCG
+struct ARAPPCGOptions
+{
+	double tolerance = 1e-10;  // relative residual
+	int maxIterations = 1000;
+};
+
+// Factorization (or preconditioner) of the symmetric positive definite A^T*A of
+// the ARAP global step. solve() only reads the backend, so it may run from
+// several jobs at once.
+class ARAPLinearSolver
+{
+public:
+	virtual ~ARAPLinearSolver() {};
+	// symbolic analysis of the sparsity pattern
+	virtual bool analyze(const Eigen::SparseMatrix<double>& K) = 0;
+	// numeric factorization; K must keep the pattern passed to analyze()
+	virtual bool factorize(const Eigen::SparseMatrix<double>& K) = 0;
+	// x = K^-1 * b, column by column; x holds the initial guess of iterative backends
+	virtual void solve(const RowMatrixXd& b, RowMatrixXd& x) const = 0;
+	virtual const char* name() const = 0;
+};
+
+// null if the backend is not compiled in
+std::unique_ptr<ARAPLinearSolver> makeLinearSolver(ARAPSolverBackend backend, const ARAPPCGOptions& pcg = ARAPPCGOptions());
+
+// "ldlt", "llt", "ldlt-metis", "cholmod", "pcg"
+const char* solverBackendName(ARAPSolverBackend backend);
+bool solverBackendFromName(const std::string& name, ARAPSolverBackend& backend);
+// the backends of this build
+std::vector<ARAPSolverBackend> availableSolverBackends();
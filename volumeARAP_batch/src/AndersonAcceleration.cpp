@@ -0,0 +1,58 @@
+#include "AndersonAcceleration.h"
+#include <algorithm>
+
+void AndersonAcceleration::init(int dim, int window, const Eigen::VectorXd& u0)
+{
+	m = std::max(window, 1);
+	dF.setZero(dim, m);
+	dG.setZero(dim, m);
+	dFScale.setZero(m);
+	M.setZero(m, m);
+	theta.setZero(m);
+	reset(u0);
+}
+
+void AndersonAcceleration::reset(const Eigen::VectorXd& u0)
+{
+	u = u0;
+	iter = 0;
+	col = 0;
+	lastHistory = 0;
+}
+
+const Eigen::VectorXd& AndersonAcceleration::compute(const Eigen::VectorXd& g)
+{
+	G = g;
+	F = g - u;
+	lastHistory = 0;
+	if (iter == 0)
+	{
+		u = g;
+	}
+	else
+	{
+		// complete the differences started in the previous call
+		dF.col(col) += F;
+		dG.col(col) += g;
+		const double eps = 1e-14;
+		double scale = std::max(eps, dF.col(col).norm());
+		dFScale(col) = scale;
+		dF.col(col) /= scale;
+
+		// Gram matrix: only the row/column of the new difference changes
+		const int mk = std::min(m, iter);
+		Eigen::VectorXd innerProd = dF.leftCols(mk).transpose() * dF.col(col);
+		M.block(col, 0, 1, mk) = innerProd.transpose();
+		M.block(0, col, mk, 1) = innerProd;
+
+		cod.compute(M.topLeftCorner(mk, mk));
+		theta.head(mk) = cod.solve(dF.leftCols(mk).transpose() * F);
+		u = g - dG.leftCols(mk) * (theta.head(mk).array() / dFScale.head(mk).array()).matrix();
+		lastHistory = mk;
+		col = (col + 1) % m;
+	}
+	dF.col(col) = -F;
+	dG.col(col) = -g;
+	iter++;
+	return u;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Eigen/Dense>
+
+// Anderson acceleration of a fixed-point iteration u <- G(u) (type II, as in
+// "Anderson Acceleration for Geometry Optimization and Physics Simulation",
+// Peng et al. 2018). The last `window` differences of residuals F = G(u) - u and
+// of G values are kept; each step returns the combination of G values whose
+// residual combination has least norm. The caller safeguards the result and
+// calls reset() to fall back to the plain iteration, e.g. from lastG().
+class AndersonAcceleration
+{
+public:
+	AndersonAcceleration() {};
+	// start a new history at u0, with vectors of size dim
+	void init(int dim, int window, const Eigen::VectorXd& u0);
+	// drop the history and continue from u
+	void reset(const Eigen::VectorXd& u);
+	// given g = G(u) of the current iterate, return the accelerated next iterate
+	const Eigen::VectorXd& compute(const Eigen::VectorXd& g);
+	// true if the last compute() combined at least two G values
+	bool accelerated() const { return lastHistory > 0; }
+	// |G(u) - u| and G(u) of the iterate passed to the last compute()
+	double residualNorm() const { return F.norm(); }
+	const Eigen::VectorXd& lastG() const { return G; }
+
+private:
+	int m = 0;  // window
+	int iter = 0;
+	int col = 0;
+	int lastHistory = 0;
+	Eigen::VectorXd u;  // current iterate
+	Eigen::VectorXd F;  // current residual
+	Eigen::VectorXd G;
+	Eigen::MatrixXd dF;  // residual differences, columns normalized
+	Eigen::MatrixXd dG;  // G differences
+	Eigen::VectorXd dFScale;
+	Eigen::MatrixXd M;  // Gram matrix of dF
+	Eigen::VectorXd theta;
+	Eigen::CompleteOrthogonalDecomposition<Eigen::MatrixXd> cod;
+};
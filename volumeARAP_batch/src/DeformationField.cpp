@@ -0,0 +1,65 @@
+#include "DeformationField.h"
+#include "MyUtils.h"
+
+bool DeformationField::build(const std::vector<Eigen::Vector3d>& rest, const std::vector<Eigen::Vector4i>& tets)
+{
+	for (const Eigen::Vector4i& t : tets)
+	{
+		if (t.minCoeff() < 0 || t.maxCoeff() >= (int)rest.size())
+		{
+			std::cerr << "Error: tet with an invalid vertex index" << std::endl;
+			return false;
+		}
+	}
+	this->rest = rest;
+	displacement.assign(rest.size(), Eigen::Vector3d::Zero());
+	tetLocator.build(rest, tets);
+	return true;
+}
+
+bool DeformationField::set_deformed(const std::vector<Eigen::Vector3d>& deformed)
+{
+	if (deformed.size() != rest.size())
+	{
+		std::cerr << "Error: " << deformed.size() << " deformed positions for " << rest.size() << " rest vertices" << std::endl;
+		return false;
+	}
+	for (int i = 0; i < (int)rest.size(); i++) displacement[i] = deformed[i] - rest[i];
+	return true;
+}
+
+bool DeformationField::load(const std::string& restFile, const std::string& deformedFile)
+{
+	std::vector<Eigen::Vector3d> verts;
+	std::vector<Eigen::Vector4i> tets;
+	if (!readTetMesh(restFile, verts, tets)) return false;
+	if (!this->build(verts, tets)) return false;
+	return this->load_deformed(deformedFile);
+}
+
+bool DeformationField::load_deformed(const std::string& deformedFile)
+{
+	std::vector<Eigen::Vector3d> verts;
+	if (!readDeformedTetMesh(deformedFile, tetLocator.n_tets(), verts)) return false;
+	return this->set_deformed(verts);
+}
+
+bool DeformationField::query(const Eigen::Vector3d& p, Eigen::Vector3d& displacement, int& cache) const
+{
+	TetLocation location;
+	if (!tetLocator.locateInside(p, location, cache))
+	{
+		displacement.setZero();
+		return false;
+	}
+	const Eigen::Vector4i& tet = tetLocator.tet(location.tet);
+	displacement = location.barycentric[0] * this->displacement[tet[0]] + location.barycentric[1] * this->displacement[tet[1]]
+		+ location.barycentric[2] * this->displacement[tet[2]] + location.barycentric[3] * this->displacement[tet[3]];
+	return true;
+}
+
+size_t DeformationField::query(const float* points, size_t n, float* displacements, unsigned char* inside, bool coherent) const
+{
+	return queryPoints(points, n, displacements, inside, coherent,
+		[this](const Eigen::Vector3d& p, Eigen::Vector3d& d, int& cache) { return this->query(p, d, cache); });
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "TetLocator.h"
+#include <string>
+
+// The ARAP deformation as a field over the rest tet mesh: a point inside a rest
+// tet moves by the barycentric blend of its corners' displacements (deformed -
+// rest). Points outside the mesh get a zero displacement and are flagged as such.
+// Batches run in parallel over contiguous chunks; each thread keeps the leaf of
+// its last hit (TetLocator::locateInside), so the samples of one ray mostly skip
+// the tree. Queries only read the field.
+class DeformationField
+{
+public:
+	DeformationField() {}
+	// rest mesh; the displacements start at zero
+	bool build(const std::vector<Eigen::Vector3d>& rest, const std::vector<Eigen::Vector4i>& tets);
+	// deformed positions of the rest vertices, in order
+	bool set_deformed(const std::vector<Eigen::Vector3d>& deformed);
+	// rest mesh: TetWild .txt, .ovm or .ovmb; deformed: the same mesh with moved vertices (arap_result_*.ovm),
+	// matched to the rest mesh by vertex order and checked only by its vertex and tet counts
+	bool load(const std::string& restFile, const std::string& deformedFile);
+	bool load_deformed(const std::string& deformedFile);
+
+	// displacement at p; false (and zero) outside the mesh. cache as in TetLocator::locateInside
+	bool query(const Eigen::Vector3d& p, Eigen::Vector3d& displacement, int& cache) const;
+	// n points, xyz each -> displacements (xyz) and inside flags (0/1, may be null);
+	// returns the number of points inside. coherent: keep the last hit leaf per thread
+	size_t query(const float* points, size_t n, float* displacements, unsigned char* inside, bool coherent = true) const;
+
+	int n_vertices() const { return (int)rest.size(); }
+	const TetLocator& locator() const { return tetLocator; }
+
+private:
+	std::vector<Eigen::Vector3d> rest, displacement;
+	TetLocator tetLocator;
+};
@@ -0,0 +1,121 @@
+#include "DeformationFieldC.h"
+#include "DeformationField.h"
+#include "InverseDeformation.h"
+#include <memory>
+
+struct ARAPField
+{
+	DeformationField field;
+};
+
+struct ARAPInverse
+{
+	InverseDeformation inverse;
+};
+
+static void toVertices(const double* xyz, int n_vertices, std::vector<Eigen::Vector3d>& verts)
+{
+	verts.resize(n_vertices);
+	for (int i = 0; i < n_vertices; i++) verts[i] = Eigen::Vector3d(xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]);
+}
+
+static void toTets(const int* tets, int n_tets, std::vector<Eigen::Vector4i>& cells)
+{
+	cells.resize(n_tets);
+	for (int t = 0; t < n_tets; t++) cells[t] = Eigen::Vector4i(tets[4 * t], tets[4 * t + 1], tets[4 * t + 2], tets[4 * t + 3]);
+}
+
+ARAPField* arap_field_load(const char* restFile, const char* deformedFile)
+{
+	std::unique_ptr<ARAPField> handle(new ARAPField());
+	if (!handle->field.load(restFile, deformedFile)) return nullptr;
+	return handle.release();
+}
+
+ARAPField* arap_field_create(const double* rest, int n_vertices, const int* tets, int n_tets)
+{
+	std::vector<Eigen::Vector3d> verts;
+	std::vector<Eigen::Vector4i> cells;
+	toVertices(rest, n_vertices, verts);
+	toTets(tets, n_tets, cells);
+	std::unique_ptr<ARAPField> handle(new ARAPField());
+	if (!handle->field.build(verts, cells)) return nullptr;
+	return handle.release();
+}
+
+void arap_field_destroy(ARAPField* field)
+{
+	delete field;
+}
+
+int arap_field_set_deformed(ARAPField* field, const double* deformed)
+{
+	std::vector<Eigen::Vector3d> verts;
+	toVertices(deformed, field->field.n_vertices(), verts);
+	return field->field.set_deformed(verts);
+}
+
+int arap_field_load_deformed(ARAPField* field, const char* deformedFile)
+{
+	return field->field.load_deformed(deformedFile);
+}
+
+int arap_field_n_vertices(const ARAPField* field)
+{
+	return field->field.n_vertices();
+}
+
+size_t arap_field_query(const ARAPField* field, const float* points, size_t n, float* displacements, unsigned char* inside)
+{
+	return field->field.query(points, n, displacements, inside);
+}
+
+ARAPInverse* arap_inverse_load(const char* restFile, const char* deformedFile)
+{
+	std::unique_ptr<ARAPInverse> handle(new ARAPInverse());
+	if (!handle->inverse.load(restFile, deformedFile)) return nullptr;
+	return handle.release();
+}
+
+ARAPInverse* arap_inverse_create(const double* rest, int n_vertices, const int* tets, int n_tets)
+{
+	std::vector<Eigen::Vector3d> verts;
+	std::vector<Eigen::Vector4i> cells;
+	toVertices(rest, n_vertices, verts);
+	toTets(tets, n_tets, cells);
+	std::unique_ptr<ARAPInverse> handle(new ARAPInverse());
+	if (!handle->inverse.build(verts, cells)) return nullptr;
+	return handle.release();
+}
+
+void arap_inverse_destroy(ARAPInverse* inverse)
+{
+	delete inverse;
+}
+
+int arap_inverse_set_deformed(ARAPInverse* inverse, const double* deformed)
+{
+	std::vector<Eigen::Vector3d> verts;
+	toVertices(deformed, inverse->inverse.n_vertices(), verts);
+	return inverse->inverse.set_deformed(verts);
+}
+
+int arap_inverse_load_deformed(ARAPInverse* inverse, const char* deformedFile)
+{
+	return inverse->inverse.load_deformed(deformedFile);
+}
+
+void arap_inverse_rebuild(ARAPInverse* inverse)
+{
+	inverse->inverse.rebuild();
+}
+
+int arap_inverse_n_vertices(const ARAPInverse* inverse)
+{
+	return inverse->inverse.n_vertices();
+}
+
+size_t arap_inverse_query(const ARAPInverse* inverse, const float* points, size_t n, float* restPoints, unsigned char* inside)
+{
+	return inverse->inverse.query(points, n, restPoints, inside);
+}
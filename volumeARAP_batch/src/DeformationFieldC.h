@@ -0,0 +1,57 @@
+#pragma once
+
+// C interface to DeformationField (rest -> deformed) and InverseDeformation
+// (deformed -> rest), built as the arapfield shared library for the renderer
+// (ctypes). Points, displacements and rest positions are float32 xyz triples,
+// inside flags one byte per point. Functions returning int give 1 on success and
+// 0 on failure, after an "Error: ..." on stderr.
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#define ARAP_FIELD_API __declspec(dllexport)
+#else
+#define ARAP_FIELD_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ARAPField ARAPField;
+typedef struct ARAPInverse ARAPInverse;
+
+// rest mesh (TetWild .txt, .ovm, .ovmb) and deformed mesh (arap_result_*.ovm); null on failure
+ARAP_FIELD_API ARAPField* arap_field_load(const char* restFile, const char* deformedFile);
+// rest vertices (xyz double) and tets (4 int each); zero displacements until set
+ARAP_FIELD_API ARAPField* arap_field_create(const double* rest, int n_vertices, const int* tets, int n_tets);
+ARAP_FIELD_API void arap_field_destroy(ARAPField* field);
+
+// a new frame: deformed positions (xyz double, n_vertices of them) or a mesh file;
+// either is matched to the rest mesh by vertex order, a file must also have its tet count
+ARAP_FIELD_API int arap_field_set_deformed(ARAPField* field, const double* deformed);
+ARAP_FIELD_API int arap_field_load_deformed(ARAPField* field, const char* deformedFile);
+
+ARAP_FIELD_API int arap_field_n_vertices(const ARAPField* field);
+// displacement (deformed - rest) at n points; inside may be null. Returns the number inside
+ARAP_FIELD_API size_t arap_field_query(const ARAPField* field, const float* points, size_t n, float* displacements, unsigned char* inside);
+
+// the inverse map; same files and arrays as above
+ARAP_FIELD_API ARAPInverse* arap_inverse_load(const char* restFile, const char* deformedFile);
+ARAP_FIELD_API ARAPInverse* arap_inverse_create(const double* rest, int n_vertices, const int* tets, int n_tets);
+ARAP_FIELD_API void arap_inverse_destroy(ARAPInverse* inverse);
+
+// a new frame: refits the tree to the deformed positions, matched by vertex order as above
+ARAP_FIELD_API int arap_inverse_set_deformed(ARAPInverse* inverse, const double* deformed);
+ARAP_FIELD_API int arap_inverse_load_deformed(ARAPInverse* inverse, const char* deformedFile);
+// a new tree for the current frame, when refitted boxes have grown too loose
+ARAP_FIELD_API void arap_inverse_rebuild(ARAPInverse* inverse);
+
+ARAP_FIELD_API int arap_inverse_n_vertices(const ARAPInverse* inverse);
+// rest positions of n deformed points (the points themselves outside the mesh);
+// inside may be null. Returns the number inside
+ARAP_FIELD_API size_t arap_inverse_query(const ARAPInverse* inverse, const float* points, size_t n, float* restPoints, unsigned char* inside);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+#include "InverseDeformation.h"
+#include "MyUtils.h"
+
+bool InverseDeformation::build(const std::vector<Eigen::Vector3d>& rest, const std::vector<Eigen::Vector4i>& tets)
+{
+	for (const Eigen::Vector4i& t : tets)
+	{
+		if (t.minCoeff() < 0 || t.maxCoeff() >= (int)rest.size())
+		{
+			std::cerr << "Error: tet with an invalid vertex index" << std::endl;
+			return false;
+		}
+	}
+	this->rest = rest;
+	this->tets = tets;
+	tetLocator.build(rest, tets);
+	return true;
+}
+
+bool InverseDeformation::set_deformed(const std::vector<Eigen::Vector3d>& deformed)
+{
+	return tetLocator.refit(deformed);
+}
+
+bool InverseDeformation::load(const std::string& restFile, const std::string& deformedFile)
+{
+	std::vector<Eigen::Vector3d> verts;
+	std::vector<Eigen::Vector4i> tets;
+	if (!readTetMesh(restFile, verts, tets)) return false;
+	if (!this->build(verts, tets)) return false;
+	return this->load_deformed(deformedFile);
+}
+
+bool InverseDeformation::load_deformed(const std::string& deformedFile)
+{
+	std::vector<Eigen::Vector3d> verts;
+	if (!readDeformedTetMesh(deformedFile, (int)this->tets.size(), verts)) return false;
+	return this->set_deformed(verts);
+}
+
+void InverseDeformation::rebuild()
+{
+	const std::vector<Eigen::Vector3d> deformed = tetLocator.positions();
+	tetLocator.build(deformed, tets);
+}
+
+bool InverseDeformation::query(const Eigen::Vector3d& p, Eigen::Vector3d& restPoint, int& cache) const
+{
+	TetLocation location;
+	if (!tetLocator.locateInside(p, location, cache))
+	{
+		restPoint = p;
+		return false;
+	}
+	const Eigen::Vector4i& tet = tets[location.tet];
+	restPoint = location.barycentric[0] * rest[tet[0]] + location.barycentric[1] * rest[tet[1]]
+		+ location.barycentric[2] * rest[tet[2]] + location.barycentric[3] * rest[tet[3]];
+	return true;
+}
+
+size_t InverseDeformation::query(const float* points, size_t n, float* restPoints, unsigned char* inside, bool coherent) const
+{
+	return queryPoints(points, n, restPoints, inside, coherent,
+		[this](const Eigen::Vector3d& p, Eigen::Vector3d& r, int& cache) { return this->query(p, r, cache); });
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "TetLocator.h"
+#include <string>
+
+// The inverse of the ARAP deformation, for rendering in deformed space: a point
+// inside a deformed tet maps to the barycentric blend of its corners' rest
+// positions. Points outside the deformed mesh map to themselves and are flagged.
+// The tree over the tets is built once, over the rest pose, and refitted to the
+// deformed positions of every frame since the topology never changes; rebuild()
+// trades a full build for tighter boxes. Batches run like DeformationField's.
+class InverseDeformation
+{
+public:
+	InverseDeformation() {}
+	// rest mesh; the identity until set_deformed()
+	bool build(const std::vector<Eigen::Vector3d>& rest, const std::vector<Eigen::Vector4i>& tets);
+	// deformed positions of the rest vertices, in order: refits the tree
+	bool set_deformed(const std::vector<Eigen::Vector3d>& deformed);
+	// rest mesh: TetWild .txt, .ovm or .ovmb; deformed: the same mesh with moved vertices (arap_result_*.ovm),
+	// matched to the rest mesh by vertex order and checked only by its vertex and tet counts
+	bool load(const std::string& restFile, const std::string& deformedFile);
+	bool load_deformed(const std::string& deformedFile);
+	// a new tree for the current deformed positions
+	void rebuild();
+
+	// rest position of the deformed point p; false (and p itself) outside the mesh.
+	// cache as in TetLocator::locateInside
+	bool query(const Eigen::Vector3d& p, Eigen::Vector3d& restPoint, int& cache) const;
+	// n points, xyz each -> rest positions (xyz) and inside flags (0/1, may be null);
+	// returns the number of points inside. coherent: keep the last hit tet per thread
+	size_t query(const float* points, size_t n, float* restPoints, unsigned char* inside, bool coherent = true) const;
+
+	int n_vertices() const { return (int)rest.size(); }
+	const TetLocator& locator() const { return tetLocator; }
+
+private:
+	std::vector<Eigen::Vector3d> rest;
+	std::vector<Eigen::Vector4i> tets;
+	TetLocator tetLocator;  // over the deformed positions
+};
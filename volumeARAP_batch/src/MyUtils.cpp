@@ -1,8 +1,22 @@
 #include "MyUtils.h"
+#include <OpenVolumeMesh/IO/ovmb_read.hh>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <sstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
 
 using namespace OpenVolumeMesh;
 
@@ -83,6 +97,21 @@ bool getCleanLine(std::istream& _ifs, std::string& _string, bool _skipEmptyLines
 bool myReadFile(const std::string& _filename, TetrahedralMesh& _mesh,
 	bool _topologyCheck, bool _computeBottomUpIncidences)
 {
+	if (_filename.size() > 5 && _filename.compare(_filename.size() - 5, 5, ".ovmb") == 0)
+	{
+		// OpenVolumeMesh binary, e.g. written by TetWild --ovmb
+		IO::ReadOptions options;
+		options.topology_check = _topologyCheck;
+		options.bottom_up_incidences = _computeBottomUpIncidences;
+		IO::ReadResult result = IO::ovmb_read(_filename.c_str(), _mesh, options);
+		if (result != IO::ReadResult::Ok)
+		{
+			std::cerr << "Error: Could not read " << _filename << ": " << IO::to_string(result) << std::endl;
+			return false;
+		}
+		return true;
+	}
+
 
 	std::ifstream iff(_filename.c_str(), std::ios::in);
 
@@ -321,26 +350,9 @@ bool myReadFile(const std::string& _filename, TetrahedralMesh& _mesh,
 	return true;
 }
 
-//template <class MeshT>
-void myWriteFile(const std::string& _filename, TetrahedralMesh &_mesh)
+// edges, faces and polyhedra sections of an ASCII OVM file
+static void writeTopology(std::ostream& off, TetrahedralMesh& _mesh)
 {
-	std::ofstream off(_filename.c_str(), std::ios::out);
-	// Write header
-	off << "OVM ASCII" << std::endl;
-
-	uint64_t n_vertices(_mesh.n_vertices());
-	off << "Vertices" << std::endl;
-	off << n_vertices << std::endl;
-
-	typedef typename TetrahedralMesh::PointT Point;
-
-	// write vertices
-	for (VertexIter v_it = _mesh.v_iter(); v_it; ++v_it) {
-
-		Point v = _mesh.vertex(*v_it);
-		off << v[0] << " " << v[1] << " " << v[2] << std::endl;
-	}
-
 	uint64_t n_edges(_mesh.n_edges());
 	off << "Edges" << std::endl;
 	off << n_edges << std::endl;
@@ -398,4 +410,248 @@ void myWriteFile(const std::string& _filename, TetrahedralMesh &_mesh)
 		off << std::endl;
 	}
 
+}
+
+//template <class MeshT>
+bool myWriteFile(const std::string& _filename, TetrahedralMesh &_mesh)
+{
+	std::ofstream off(_filename.c_str(), std::ios::out);
+	// Write header
+	off << "OVM ASCII" << std::endl;
+
+	uint64_t n_vertices(_mesh.n_vertices());
+	off << "Vertices" << std::endl;
+	off << n_vertices << std::endl;
+
+	typedef typename TetrahedralMesh::PointT Point;
+
+	// write vertices
+	for (VertexIter v_it = _mesh.v_iter(); v_it; ++v_it) {
+
+		Point v = _mesh.vertex(*v_it);
+		off << v[0] << " " << v[1] << " " << v[2] << std::endl;
+	}
+
+	writeTopology(off, _mesh);
+	off.close();
+	if (off.fail()) {
+		std::cerr << "Error: Could not write file " << _filename << "!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool myWriteFile(const std::string& _filename, TetrahedralMesh& _mesh, const std::vector<Eigen::Vector3d>& positions)
+{
+	std::ofstream off(_filename.c_str(), std::ios::out);
+	// Write header
+	off << "OVM ASCII" << std::endl;
+
+	uint64_t n_vertices(_mesh.n_vertices());
+	off << "Vertices" << std::endl;
+	off << n_vertices << std::endl;
+
+	// write vertices
+	for (uint64_t i = 0u; i < n_vertices; ++i) {
+
+		const Eigen::Vector3d& v = positions[i];
+		off << v[0] << " " << v[1] << " " << v[2] << std::endl;
+	}
+
+	writeTopology(off, _mesh);
+	off.close();
+	if (off.fail()) {
+		std::cerr << "Error: Could not write file " << _filename << "!" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void buildTetMesh(TetrahedralMesh& _mesh, const std::vector<Eigen::Vector3d>& verts, const std::vector<Eigen::Vector4i>& tets)
+{
+	for (const Eigen::Vector3d& v : verts) {
+		_mesh.add_vertex(EtoOV(v));
+	}
+
+	// the faces of tet (0, 1, 2, 3), each facing the opposite vertex
+	static const int tetFaces[4][3] = { { 0, 1, 2 }, { 0, 2, 3 }, { 0, 3, 1 }, { 1, 3, 2 } };
+	std::map<std::array<int, 3>, FaceHandle> faces;
+	for (const Eigen::Vector4i& t : tets) {
+		std::vector<HalfFaceHandle> halffaces;
+		for (int f = 0; f < 4; f++) {
+			int a = t[tetFaces[f][0]], b = t[tetFaces[f][1]], c = t[tetFaces[f][2]];
+			std::array<int, 3> key = { a, b, c };
+			std::sort(key.begin(), key.end());
+			auto it = faces.find(key);
+			if (it == faces.end()) {
+				std::vector<VertexHandle> vs = { VertexHandle(a), VertexHandle(b), VertexHandle(c) };
+				FaceHandle fh = _mesh.add_face(vs);
+				faces[key] = fh;
+				halffaces.push_back(_mesh.halfface_handle(fh, 0));
+			}
+			else {
+				// a neighbour of a consistently oriented mesh sees the shared face the other way round
+				halffaces.push_back(_mesh.halfface_handle(it->second, 1));
+			}
+		}
+		_mesh.add_cell(halffaces);
+	}
+}
+
+bool readTetMesh(const std::string& _filename, std::vector<Eigen::Vector3d>& verts, std::vector<Eigen::Vector4i>& tets)
+{
+	verts.clear();
+	tets.clear();
+	if (_filename.size() > 4 && _filename.compare(_filename.size() - 4, 4, ".txt") == 0)
+	{
+		std::ifstream iff(_filename.c_str());
+		int n = -1;
+		iff >> n;
+		for (int i = 0; i < n && iff; i++)
+		{
+			Eigen::Vector3d v;
+			iff >> v[0] >> v[1] >> v[2];
+			verts.push_back(v);
+		}
+		n = -1;
+		iff >> n;
+		for (int i = 0; i < n && iff; i++)
+		{
+			Eigen::Vector4i t;
+			iff >> t[0] >> t[1] >> t[2] >> t[3];
+			tets.push_back(t);
+		}
+		if (!iff || n < 0)
+		{
+			std::cerr << "Error: Could not read tet mesh " << _filename << std::endl;
+			return false;
+		}
+		for (const Eigen::Vector4i& t : tets)
+		{
+			if (t.minCoeff() < 0 || t.maxCoeff() >= (int)verts.size())
+			{
+				std::cerr << "Error: " << _filename << " has a tet with an invalid vertex index" << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+	TetrahedralMesh mesh;
+	if (!myReadFile(_filename, mesh, true, false)) return false;
+	verts.resize(mesh.n_vertices());
+	for (int i = 0; i < verts.size(); i++) verts[i] = OVtoE(mesh.vertex(VertexHandle(i)));
+	tets.resize(mesh.n_cells());
+	for (int c = 0; c < tets.size(); c++)
+	{
+		int m = 0;
+		for (CellVertexIter cvit = mesh.cv_iter(CellHandle(c)); cvit.valid() && m < 4; cvit++) tets[c][m++] = cvit->idx();
+		if (m < 4)
+		{
+			std::cerr << "Error: cell " << c << " of " << _filename << " is not a tet" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool readDeformedTetMesh(const std::string& _filename, int n_tets, std::vector<Eigen::Vector3d>& verts)
+{
+	std::vector<Eigen::Vector4i> tets;
+	if (!readTetMesh(_filename, verts, tets)) return false;
+	if ((int)tets.size() != n_tets)
+	{
+		std::cerr << "Error: " << _filename << " has " << tets.size() << " tets but the rest mesh has " << n_tets << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool readObjVertices(const std::string& _filename, std::vector<Eigen::Vector3d>& verts)
+{
+	std::ifstream iff(_filename.c_str());
+	if (!iff.good())
+	{
+		std::cerr << "Error: Could not open file " << _filename << " for reading!" << std::endl;
+		return false;
+	}
+	verts.clear();
+	std::string line;
+	while (std::getline(iff, line))
+	{
+		if (line.size() < 2 || line[0] != 'v' || (line[1] != ' ' && line[1] != '\t')) continue;
+		std::istringstream sstr(line.substr(2));
+		Eigen::Vector3d v;
+		if (!(sstr >> v[0] >> v[1] >> v[2]))
+		{
+			std::cerr << "Error: bad vertex line in " << _filename << ": " << line << std::endl;
+			return false;
+		}
+		verts.push_back(v);
+	}
+	return true;
+}
+
+double peakMemoryMB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0);  // bytes
+#else
+	return usage.ru_maxrss / 1024.0;  // kilobytes
+#endif
+#endif
+}
+
+#ifdef _WIN32
+static double fileTimeMs(const FILETIME& kernel, const FILETIME& user)
+{
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) / 1e4;  // 100 ns units
+}
+#endif
+
+double processCpuMs()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+	return fileTimeMs(kernel, user);
+#else
+	timespec t;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t) != 0) return 0;
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+#endif
+}
+
+double threadCpuMs()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+	return fileTimeMs(kernel, user);
+#else
+	timespec t;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t) != 0) return 0;
+	return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+#endif
+}
+
+std::string jsonNumber(double x)
+{
+	if (std::isnan(x)) return "null";
+	if (std::isinf(x)) return x > 0 ? "1e308" : "-1e308";
+	std::ostringstream oss;
+	oss.precision(17);
+	oss << x;
+	return oss.str();
 }
\ No newline at end of file
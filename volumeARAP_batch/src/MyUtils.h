@@ -30,15 +30,80 @@ Eigen::Vector3d OVtoE(const Tet_vec3d &v);
 Eigen::Matrix3d exp(Eigen::Matrix3d);
 Eigen::Matrix3d log(Eigen::Matrix3d);
 
+// closest rotation R (det(R) = +1) maximizing tr(R * S) for the ARAP covariance S = sum(e_ij * e'_ij^T),
+// in the precision of S
+template <typename Scalar>
+Eigen::Matrix<Scalar, 3, 3> fitRotation(const Eigen::Matrix<Scalar, 3, 3>& S) {
+	typedef Eigen::Matrix<Scalar, 3, 3> Matrix3;
+	typedef Eigen::Matrix<Scalar, 3, 1> Vector3;
+	// closed-form polar decomposition: S^T*S = V * Sigma^2 * V^T, U = S * V * Sigma^-1, R = V * U^T.
+	// The third column of U is u1 x u2 and its sign is chosen so that det(R) = +1, which is the
+	// same result as flipping the column of the smallest singular value after an SVD.
+	Eigen::SelfAdjointEigenSolver<Matrix3> eig;
+	eig.computeDirect(S.transpose() * S);
+	const Vector3& lambda = eig.eigenvalues();  // ascending
+	const Matrix3& V = eig.eigenvectors();
+	const Scalar rankTolerance = std::max(Scalar(1e-8), 100 * Eigen::NumTraits<Scalar>::epsilon());
+	if (!(lambda[1] > rankTolerance * lambda[2]))
+	{
+		// (nearly) rank < 2, the polar factor is not well defined: fall back to the fixed-size SVD
+		Eigen::JacobiSVD<Matrix3> svd(S, Eigen::ComputeFullU | Eigen::ComputeFullV);
+		Matrix3 U = svd.matrixU();
+		Matrix3 R = svd.matrixV() * U.transpose();
+		if (R.determinant() < 0)
+		{
+			U.col(2) = -U.col(2);
+			R = svd.matrixV() * U.transpose();
+		}
+		return R;
+	}
+	Vector3 u1 = (S * V.col(2)).normalized();
+	Vector3 u2 = S * V.col(1);
+	u2 = (u2 - u1.dot(u2) * u1).normalized();
+	Vector3 u3 = u1.cross(u2);
+	// det([v3 v2 v1]) = -det(V)
+	Scalar s = V.determinant() < 0 ? Scalar(1) : Scalar(-1);
+	return V.col(2) * u1.transpose() + V.col(1) * u2.transpose() + s * V.col(0) * u3.transpose();
+}
+
 void trimString(std::string& _string);
 
 bool getCleanLine(std::istream& ifs, std::string& _string, bool _skipEmptyLines = true);
 
+// ASCII .ovm, or OpenVolumeMesh binary when _filename ends in .ovmb
 bool myReadFile(const std::string& _filename, TetrahedralMesh& _mesh,
 	bool _topologyCheck = true,
 	bool _computeBottomUpIncidences = true);
 
-void myWriteFile(const std::string& _filename, TetrahedralMesh& _mesh);
+// ASCII .ovm; false if the file could not be written
+bool myWriteFile(const std::string& _filename, TetrahedralMesh& _mesh);
+
+// write the topology of _mesh with the vertex positions taken from positions
+bool myWriteFile(const std::string& _filename, TetrahedralMesh& _mesh, const std::vector<Eigen::Vector3d>& positions);
+
+// vertices and tets of a tet mesh: a TetWild .txt (vertex count, xyz rows, tet count,
+// index rows) or anything myReadFile reads, with each cell's four vertices
+bool readTetMesh(const std::string& _filename, std::vector<Eigen::Vector3d>& verts, std::vector<Eigen::Vector4i>& tets);
+
+// vertices of a deformed copy of a tet mesh with n_tets tets (arap_result_*.ovm); only the
+// vertex order is used, so a file with another tet count is taken for another mesh and refused
+bool readDeformedTetMesh(const std::string& _filename, int n_tets, std::vector<Eigen::Vector3d>& verts);
+
+// the "v x y z" lines of an OBJ file, in order
+bool readObjVertices(const std::string& _filename, std::vector<Eigen::Vector3d>& verts);
+
+// build _mesh from positively oriented tets, sharing faces between neighbours
+// (half-face orientation as in OpenVolumeMesh's tetrahedral kernel)
+void buildTetMesh(TetrahedralMesh& _mesh, const std::vector<Eigen::Vector3d>& verts, const std::vector<Eigen::Vector4i>& tets);
+
+// peak resident set size of this process so far, in MB
+double peakMemoryMB();
+// CPU time of this process (all threads) / of the calling thread, in ms from an arbitrary origin
+double processCpuMs();
+double threadCpuMs();
+
+// x for a JSON file: full precision, null for NaN, +-1e308 for infinities
+std::string jsonNumber(double x);
 
 //template <class MeshT>
 //void myWriteFile(const std::string& _filename, MeshT& _mesh);
@@ -0,0 +1,366 @@
+#include "TetLocator.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+
+void TetLocator::build(const std::vector<Eigen::Vector3d>& vertices, const std::vector<Eigen::Vector4i>& tets)
+{
+	this->vertices = vertices;
+	this->tets = tets;
+	order.resize(tets.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::vector<Eigen::Vector3d> centroids(tets.size());
+	for (int t = 0; t < (int)tets.size(); t++)
+	{
+		centroids[t] = 0.25 * (vertices[tets[t][0]] + vertices[tets[t][1]] + vertices[tets[t][2]] + vertices[tets[t][3]]);
+	}
+	nodes.clear();
+	nodes.reserve(2 * tets.size() / leafSize + 1);
+	leafTets.clear();
+	leafTets.reserve(tets.size() / 2 / leafSize + 1);
+	lanes.resize(tets.size());
+	if (!tets.empty()) this->buildNode(centroids, 0, (int)tets.size());
+	this->buildNeighbors();
+}
+
+bool TetLocator::refit(const std::vector<Eigen::Vector3d>& vertices)
+{
+	if (vertices.size() != this->vertices.size())
+	{
+		std::cerr << "Error: refit with " << vertices.size() << " vertices, the tree has " << this->vertices.size() << std::endl;
+		return false;
+	}
+	this->vertices = vertices;
+#pragma omp parallel for schedule(static)
+	for (int index = 0; index < (int)nodes.size(); index++)
+	{
+		Node& node = nodes[index];
+		if (node.count == 0) continue;
+		node.box.setEmpty();
+		for (int k = node.first; k < node.first + node.count; k++)
+		{
+			for (int m = 0; m < 4; m++) node.box.extend(vertices[tets[order[k]][m]]);
+		}
+		this->buildLeafTets(node);
+	}
+	// children come after their parent
+	for (int index = (int)nodes.size() - 1; index >= 0; index--)
+	{
+		Node& node = nodes[index];
+		if (node.count == 0) node.box = nodes[index + 1].box.merged(nodes[node.right].box);
+	}
+	return true;
+}
+
+void TetLocator::buildNeighbors()
+{
+	// vertex -> incident tets, CSR
+	std::vector<int> offsets(vertices.size() + 1, 0), incident(4 * tets.size());
+	for (const Eigen::Vector4i& t : tets)
+	{
+		for (int m = 0; m < 4; m++) offsets[t[m] + 1]++;
+	}
+	for (int v = 0; v < (int)vertices.size(); v++) offsets[v + 1] += offsets[v];
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int t = 0; t < (int)tets.size(); t++)
+	{
+		for (int m = 0; m < 4; m++) incident[fill[tets[t][m]]++] = t;
+	}
+	neighbors.assign(tets.size(), Eigen::Vector4i::Constant(-1));
+#pragma omp parallel for schedule(static)
+	for (int t = 0; t < (int)tets.size(); t++)
+	{
+		const Eigen::Vector4i& tet = tets[t];
+		for (int m = 0; m < 4; m++)
+		{
+			// the other tet on the face opposite to vertex m shares all three of its vertices
+			const int a = tet[(m + 1) % 4], b = tet[(m + 2) % 4], c = tet[(m + 3) % 4];
+			for (int k = offsets[a]; k < offsets[a + 1]; k++)
+			{
+				const int u = incident[k];
+				if (u == t) continue;
+				const Eigen::Vector4i& other = tets[u];
+				if ((other.array() == b).any() && (other.array() == c).any())
+				{
+					neighbors[t][m] = u;
+					break;
+				}
+			}
+		}
+	}
+}
+
+int TetLocator::buildNode(std::vector<Eigen::Vector3d>& centroids, int first, int count)
+{
+	const int index = (int)nodes.size();
+	nodes.push_back(Node());
+	Eigen::AlignedBox3d box, centroidBox;
+	for (int k = first; k < first + count; k++)
+	{
+		const Eigen::Vector4i& t = tets[order[k]];
+		for (int m = 0; m < 4; m++) box.extend(vertices[t[m]]);
+		centroidBox.extend(centroids[order[k]]);
+	}
+	nodes[index].box = box;
+	if (count <= leafSize)
+	{
+		nodes[index].first = first;
+		nodes[index].count = count;
+		nodes[index].right = (int)leafTets.size();
+		leafTets.push_back(LeafTets());
+		this->buildLeafTets(nodes[index]);
+		return index;
+	}
+	int axis;
+	centroidBox.sizes().maxCoeff(&axis);
+	const int half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+	this->buildNode(centroids, first, half);
+	const int right = this->buildNode(centroids, first + half, count - half);
+	nodes[index].first = first;
+	nodes[index].count = 0;
+	nodes[index].right = right;
+	return index;
+}
+
+int TetLocator::depth() const
+{
+	if (nodes.empty()) return 0;
+	int maxDepth = 0;
+	std::vector<std::pair<int, int>> stack(1, std::make_pair(0, 1));
+	while (!stack.empty())
+	{
+		const std::pair<int, int> top = stack.back();
+		stack.pop_back();
+		maxDepth = std::max(maxDepth, top.second);
+		const Node& node = nodes[top.first];
+		if (node.count > 0) continue;
+		stack.push_back(std::make_pair(top.first + 1, top.second + 1));
+		stack.push_back(std::make_pair(node.right, top.second + 1));
+	}
+	return maxDepth;
+}
+
+bool TetLocator::barycentric(int t, const Eigen::Vector3d& p, Eigen::Vector4d& bary) const
+{
+	const Eigen::Vector4i& tet = tets[t];
+	const Eigen::Vector3d& a = vertices[tet[0]];
+	const Eigen::Vector3d e1 = vertices[tet[1]] - a, e2 = vertices[tet[2]] - a, e3 = vertices[tet[3]] - a, d = p - a;
+	const Eigen::Vector3d n23 = e2.cross(e3);
+	const double det = e1.dot(n23);
+	if (det == 0) return false;
+	const double inv = 1.0 / det;
+	bary[1] = d.dot(n23) * inv;
+	bary[2] = e1.dot(d.cross(e3)) * inv;
+	bary[3] = e1.dot(e2.cross(d)) * inv;
+	bary[0] = 1 - bary[1] - bary[2] - bary[3];
+	return true;
+}
+
+void TetLocator::buildLeafTets(const Node& leaf)
+{
+	LeafTets& block = leafTets[leaf.right];
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	for (int l = 0; l < leafSize; l++)
+	{
+		for (int c = 0; c < 3; c++) block.origin[c][l] = nan;
+		for (int k = 0; k < 9; k++) block.map[k][l] = nan;
+		if (l >= leaf.count) continue;
+		lanes[order[leaf.first + l]] = leaf.right * leafSize + l;
+		const Eigen::Vector4i& tet = tets[order[leaf.first + l]];
+		const Eigen::Vector3d& a = vertices[tet[0]];
+		const Eigen::Vector3d e1 = vertices[tet[1]] - a, e2 = vertices[tet[2]] - a, e3 = vertices[tet[3]] - a;
+		const double det = e1.dot(e2.cross(e3));
+		if (det == 0) continue;
+		// rows of the inverse of [e1 e2 e3], as in barycentric()
+		Eigen::Matrix3d inverse;
+		inverse.row(0) = e2.cross(e3) / det;
+		inverse.row(1) = e3.cross(e1) / det;
+		inverse.row(2) = e1.cross(e2) / det;
+		for (int c = 0; c < 3; c++) block.origin[c][l] = a[c];
+		for (int k = 0; k < 9; k++) block.map[k][l] = inverse(k / 3, k % 3);
+	}
+}
+
+bool TetLocator::leafContaining(const Node& leaf, const Eigen::Vector3d& p, TetLocation& location) const
+{
+	const LeafTets& block = leafTets[leaf.right];
+	const Eigen::Array4d dx = p.x() - block.origin[0], dy = p.y() - block.origin[1], dz = p.z() - block.origin[2];
+	const Eigen::Array4d b1 = block.map[0] * dx + block.map[1] * dy + block.map[2] * dz;
+	const Eigen::Array4d b2 = block.map[3] * dx + block.map[4] * dy + block.map[5] * dz;
+	const Eigen::Array4d b3 = block.map[6] * dx + block.map[7] * dy + block.map[8] * dz;
+	const Eigen::Array4d b0 = 1 - b1 - b2 - b3;
+	const Eigen::Array4d lowest = b0.min(b1).min(b2.min(b3));
+	for (int l = 0; l < leaf.count; l++)
+	{
+		if (!(lowest[l] >= -tolerance)) continue;
+		location.tet = order[leaf.first + l];
+		location.barycentric = Eigen::Vector4d(b0[l], b1[l], b2[l], b3[l]);
+		location.inside = true;
+		location.distance = 0;
+		return true;
+	}
+	return false;
+}
+
+bool TetLocator::walk(int start, const Eigen::Vector3d& p, TetLocation& location) const
+{
+	int t = start;
+	for (int step = 0; step < maxWalk && t >= 0; step++)
+	{
+		const LeafTets& block = leafTets[lanes[t] / leafSize];
+		const int l = lanes[t] % leafSize;
+		const double dx = p.x() - block.origin[0][l], dy = p.y() - block.origin[1][l], dz = p.z() - block.origin[2][l];
+		Eigen::Vector4d bary;
+		bary[1] = block.map[0][l] * dx + block.map[1][l] * dy + block.map[2][l] * dz;
+		bary[2] = block.map[3][l] * dx + block.map[4][l] * dy + block.map[5][l] * dz;
+		bary[3] = block.map[6][l] * dx + block.map[7][l] * dy + block.map[8][l] * dz;
+		bary[0] = 1 - bary[1] - bary[2] - bary[3];
+		int m;
+		const double lowest = bary.minCoeff(&m);
+		if (lowest >= -tolerance)
+		{
+			location.tet = t;
+			location.barycentric = bary;
+			location.inside = true;
+			location.distance = 0;
+			return true;
+		}
+		// NaN: a degenerate tet, which gives no direction
+		if (!(lowest < 0)) return false;
+		t = neighbors[t][m];
+	}
+	return false;
+}
+
+bool TetLocator::findContaining(const Eigen::Vector3d& p, TetLocation& location, int& cache) const
+{
+	if (cache >= 0 && this->walk(cache, p, location))
+	{
+		cache = location.tet;
+		return true;
+	}
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const int index = stack[--top];
+		const Node& node = nodes[index];
+		if (!node.box.contains(p)) continue;
+		if (node.count == 0)
+		{
+			stack[top++] = node.right;
+			stack[top++] = index + 1;
+			continue;
+		}
+		if (this->leafContaining(node, p, location))
+		{
+			cache = location.tet;
+			return true;
+		}
+	}
+	return false;
+}
+
+// closest point to p on triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+static Eigen::Vector3d closestOnTriangle(const Eigen::Vector3d& p, const Eigen::Vector3d& a, const Eigen::Vector3d& b, const Eigen::Vector3d& c)
+{
+	const Eigen::Vector3d ab = b - a, ac = c - a, ap = p - a;
+	const double d1 = ab.dot(ap), d2 = ac.dot(ap);
+	if (d1 <= 0 && d2 <= 0) return a;
+	const Eigen::Vector3d bp = p - b;
+	const double d3 = ab.dot(bp), d4 = ac.dot(bp);
+	if (d3 >= 0 && d4 <= d3) return b;
+	const double vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + d1 / (d1 - d3) * ab;
+	const Eigen::Vector3d cp = p - c;
+	const double d5 = ab.dot(cp), d6 = ac.dot(cp);
+	if (d6 >= 0 && d5 <= d6) return c;
+	const double vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + d2 / (d2 - d6) * ac;
+	const double va = d3 * d6 - d5 * d4;
+	if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+	const double denom = 1 / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+void TetLocator::findNearest(const Eigen::Vector3d& p, TetLocation& location) const
+{
+	static const int faces[4][3] = { { 0, 1, 2 }, { 0, 2, 3 }, { 0, 3, 1 }, { 1, 3, 2 } };
+	double best = std::numeric_limits<double>::infinity();  // squared distance
+	int stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	Eigen::Vector4d bary;
+	while (top > 0)
+	{
+		const int index = stack[--top];
+		const Node& node = nodes[index];
+		if (node.box.squaredExteriorDistance(p) >= best) continue;
+		if (node.count == 0)
+		{
+			// nearer child on top
+			const double left = nodes[index + 1].box.squaredExteriorDistance(p);
+			const double right = nodes[node.right].box.squaredExteriorDistance(p);
+			if (left < right)
+			{
+				stack[top++] = node.right;
+				stack[top++] = index + 1;
+			}
+			else
+			{
+				stack[top++] = index + 1;
+				stack[top++] = node.right;
+			}
+			continue;
+		}
+		for (int k = node.first; k < node.first + node.count; k++)
+		{
+			const int t = order[k];
+			if (!this->barycentric(t, p, bary)) continue;
+			const Eigen::Vector4i& tet = tets[t];
+			for (int f = 0; f < 4; f++)
+			{
+				const Eigen::Vector3d q = closestOnTriangle(p, vertices[tet[faces[f][0]]], vertices[tet[faces[f][1]]], vertices[tet[faces[f][2]]]);
+				const double d = (q - p).squaredNorm();
+				if (d >= best) continue;
+				best = d;
+				this->barycentric(t, q, bary);
+				bary = bary.cwiseMax(0.0).cwiseMin(1.0);
+				location.tet = t;
+				location.barycentric = bary / bary.sum();
+			}
+		}
+	}
+	location.inside = false;
+	location.distance = std::sqrt(best);
+}
+
+TetLocation TetLocator::locate(const Eigen::Vector3d& p) const
+{
+	TetLocation location;
+	if (nodes.empty()) return location;
+	int cache = -1;
+	if (!this->findContaining(p, location, cache)) this->findNearest(p, location);
+	return location;
+}
+
+bool TetLocator::locateInside(const Eigen::Vector3d& p, TetLocation& location, int& cache) const
+{
+	if (nodes.empty()) return false;
+	return this->findContaining(p, location, cache);
+}
+
+void TetLocator::locate(const std::vector<Eigen::Vector3d>& points, std::vector<TetLocation>& locations) const
+{
+	locations.resize(points.size());
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int i = 0; i < (int)points.size(); i++)
+	{
+		locations[i] = this->locate(points[i]);
+	}
+}
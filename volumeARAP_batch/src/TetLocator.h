@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <vector>
+
+// where a point falls in a tet mesh
+struct TetLocation
+{
+	int tet = -1;  // index into the tets the locator was built from; -1 only for an empty mesh
+	Eigen::Vector4d barycentric = Eigen::Vector4d::Zero();  // sums to one
+	bool inside = false;  // false: tet is the nearest one, barycentric that of the closest point on it
+	double distance = 0;  // from the point to tet, 0 when inside
+};
+
+// Point location in a tet mesh through a BVH over the tets: a binary tree split at
+// the median centroid along the longest axis, with up to leafSize tets per leaf,
+// stored depth-first so that a node's left child follows it. A point is inside a
+// tet if none of its barycentric coordinates is below -tolerance. Points outside
+// every tet get the nearest non-degenerate tet, found by a branch-and-bound descent
+// over the box distances, with the barycentrics of the closest point on it (clamped
+// to [0, 1]). The tets of a leaf are kept side by side as affine maps to their
+// barycentric coordinates, so a leaf is tested with one 4-wide evaluation.
+// locateInside() first walks from a cached tet towards p across the face of its
+// most negative barycentric coordinate, which is much cheaper than the tree when
+// successive points are close, as the samples along a ray are.
+// Queries only read the tree, so they may run concurrently.
+class TetLocator
+{
+public:
+	double tolerance = 1e-9;
+
+	TetLocator() {}
+	TetLocator(const std::vector<Eigen::Vector3d>& vertices, const std::vector<Eigen::Vector4i>& tets) { this->build(vertices, tets); }
+	void build(const std::vector<Eigen::Vector3d>& vertices, const std::vector<Eigen::Vector4i>& tets);
+	// new positions of the same vertices: the boxes and leaf maps are recomputed bottom-up
+	// and the tree is kept. Much cheaper than build(), but a tree refitted to a strongly
+	// deformed mesh has looser boxes than one built for it. false on a vertex count mismatch
+	bool refit(const std::vector<Eigen::Vector3d>& vertices);
+
+	TetLocation locate(const Eigen::Vector3d& p) const;
+	// every point, in parallel
+	void locate(const std::vector<Eigen::Vector3d>& points, std::vector<TetLocation>& locations) const;
+	// the tet containing p, without the nearest-tet fallback: false when p is outside
+	// every tet. cache (-1 to start, one per thread) keeps the last hit tet, where
+	// the walk starts; the tree is searched when the walk leaves the mesh or stalls.
+	bool locateInside(const Eigen::Vector3d& p, TetLocation& location, int& cache) const;
+
+	int n_tets() const { return (int)tets.size(); }
+	const std::vector<Eigen::Vector3d>& positions() const { return vertices; }
+	const Eigen::Vector4i& tet(int t) const { return tets[t]; }
+	int depth() const;
+
+private:
+	static const int leafSize = 4;
+	static const int maxWalk = 4;
+	struct Node
+	{
+		Eigen::AlignedBox3d box;
+		int first, count;  // leaf: tets order[first .. first + count); inner node: count == 0
+		int right;  // inner node: index of the right child, the left one is the next node; leaf: its LeafTets
+	};
+	// lane l: tet order[first + l] of a leaf as barycentric[1..3] = map * (p - origin),
+	// row-major; unused lanes and degenerate tets are NaN, so they never contain p
+	struct LeafTets
+	{
+		Eigen::Array4d origin[3];
+		Eigen::Array4d map[9];
+	};
+	std::vector<Eigen::Vector3d> vertices;
+	std::vector<Eigen::Vector4i> tets;
+	std::vector<int> order;  // leaf order -> input tet index
+	std::vector<Node> nodes;
+	std::vector<LeafTets> leafTets;
+	std::vector<int> lanes;  // input tet index -> LeafTets index * leafSize + lane
+	std::vector<Eigen::Vector4i> neighbors;  // per tet, the tet across the face opposite to each vertex, -1 on the boundary
+
+	int buildNode(std::vector<Eigen::Vector3d>& centroids, int first, int count);
+	// barycentric coordinates of p in tet t; false for a degenerate tet
+	bool barycentric(int t, const Eigen::Vector3d& p, Eigen::Vector4d& bary) const;
+	void buildLeafTets(const Node& leaf);
+	void buildNeighbors();
+	// first tet of the leaf containing p
+	bool leafContaining(const Node& leaf, const Eigen::Vector3d& p, TetLocation& location) const;
+	// from tet start towards p, at most maxWalk tets
+	bool walk(int start, const Eigen::Vector3d& p, TetLocation& location) const;
+	bool findContaining(const Eigen::Vector3d& p, TetLocation& location, int& cache) const;
+	void findNearest(const Eigen::Vector3d& p, TetLocation& location) const;
+};
+
+// The batch loop of DeformationField and InverseDeformation: query(p, result, cache)
+// for n points (xyz each) in parallel, results as xyz floats and the returned flags
+// in inside (may be null); returns the number of flagged points. Chunks of
+// consecutive points keep the samples of a ray on one thread, and with coherent
+// each thread carries its cache (see TetLocator::locateInside) from point to point.
+template <class Query>
+size_t queryPoints(const float* points, size_t n, float* results, unsigned char* inside, bool coherent, const Query& query)
+{
+	size_t n_inside = 0;
+#pragma omp parallel reduction(+:n_inside)
+	{
+		int cache = -1;
+#pragma omp for schedule(dynamic, 1024)
+		for (long long i = 0; i < (long long)n; i++)
+		{
+			if (!coherent) cache = -1;
+			const Eigen::Vector3d p(points[3 * i], points[3 * i + 1], points[3 * i + 2]);
+			Eigen::Vector3d r;
+			const bool hit = query(p, r, cache);
+			for (int c = 0; c < 3; c++) results[3 * i + c] = (float)r[c];
+			if (inside) inside[i] = hit;
+			n_inside += hit;
+		}
+	}
+	return n_inside;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Fixed-size pool of worker threads running queued jobs in FIFO order.
+// With more than one worker, OpenMP regions started by a job run on a single
+// thread, so the pool does not oversubscribe the cores it already uses.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int numThreads)
+	{
+		if (numThreads <= 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+		const bool serialOpenMP = numThreads > 1;
+		for (int i = 0; i < numThreads; i++)
+		{
+			workers.emplace_back([this, serialOpenMP]() { this->worker(serialOpenMP); });
+		}
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (std::thread& t : workers) t.join();
+	}
+
+	void submit(std::function<void()> job)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobs.push(std::move(job));
+		}
+		jobAvailable.notify_one();
+	}
+
+	// block until every submitted job has finished
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		jobsDone.wait(lock, [this]() { return jobs.empty() && running == 0; });
+	}
+
+	int size() const { return (int)workers.size(); }
+
+private:
+	void worker(bool serialOpenMP)
+	{
+#ifdef _OPENMP
+		if (serialOpenMP) omp_set_num_threads(1);
+#endif
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (jobs.empty()) return;
+				job = std::move(jobs.front());
+				jobs.pop();
+				running++;
+			}
+			job();
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				running--;
+				if (jobs.empty() && running == 0) jobsDone.notify_all();
+			}
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobsDone;
+	int running = 0;
+	bool stopping = false;
+};
@@ -1,27 +1,282 @@
 #include <string>
 //#include <direct.h>
 #include "ARAPDeform.h"
+#include "ARAPBatch.h"
+#include "ARAPHierarchy.h"
+#include "ARAPRegion.h"
+#include "TetLocator.h"
+#include <chrono>
 //#include "fileSystemUtility.h"
 //#include "MatEngine.h"
 
+// consume one per-frame iteration option at argv[i] (and its value); false if argv[i] is not one
+static bool parseIterationOption(int argc, char *argv[], int& i, ARAPBatchOptions& options)
+{
+	std::string arg = argv[i];
+	if (arg == "--max-iter" && i + 1 < argc) options.maxIterTime = atoi(argv[++i]);
+	else if (arg == "--tol" && i + 1 < argc) options.tolerance = atof(argv[++i]);
+	else if (arg == "--anderson" && i + 1 < argc) options.andersonWindow = atoi(argv[++i]);
+	else if (arg == "--energy") options.convergence = ARAP_ENERGY;
+	else if (arg == "--no-warm-start") options.warmStart = false;
+	else if (arg == "--max-weight" && i + 1 < argc) options.weights.maxWeight = atof(argv[++i]);
+	else if (arg == "--min-weight" && i + 1 < argc)
+	{
+		options.weights.enforcePositive = true;
+		options.weights.minWeight = atof(argv[++i]);
+	}
+	else if (arg == "--degenerate-quality" && i + 1 < argc) options.weights.degenerateQuality = atof(argv[++i]);
+	else if (arg == "--weight-report" && i + 1 < argc) options.weightReport = argv[++i];
+	else if (arg == "--output" && i + 1 < argc)
+	{
+		std::string format = argv[++i];
+		if (format == "positions") options.outputFormat = ARAP_OUTPUT_POSITIONS;
+		else if (format == "deltas") options.outputFormat = ARAP_OUTPUT_DELTAS;
+		else if (format == "ovm") options.outputFormat = ARAP_OUTPUT_OVM;
+		else
+		{
+			std::cerr << "unknown output format " << format << std::endl;
+			return false;
+		}
+	}
+	else if (arg == "--solver" && i + 1 < argc)
+	{
+		if (!solverBackendFromName(argv[++i], options.solverBackend))
+		{
+			std::cerr << "unknown solver " << argv[i] << std::endl;
+			return false;
+		}
+	}
+	else if (arg == "--matrix-free") options.matrixFree = true;
+	else if (arg == "--cg-tol" && i + 1 < argc) options.cg.tolerance = atof(argv[++i]);
+	else if (arg == "--cg-max-iter" && i + 1 < argc) options.cg.maxIterations = atoi(argv[++i]);
+	else if (arg == "--mixed-precision") options.mixedPrecision = true;
+	else if (arg == "--profile" && i + 1 < argc) options.profile = argv[++i];
+	else if (arg == "--refine" && i + 1 < argc) options.refinementSteps = atoi(argv[++i]);
+	else if (arg == "--rotation-kernel" && i + 1 < argc)
+	{
+		if (!rotationKernelFromName(argv[++i], options.rotationKernel) || !rotationKernelAvailable(options.rotationKernel))
+		{
+			options.rotationKernel = detectRotationKernel();
+			std::cerr << "rotation kernel " << argv[i] << " is not available, using " << rotationKernelName(options.rotationKernel) << std::endl;
+		}
+	}
+	else return false;
+	return true;
+}
+
+// phase table and peak memory of the run, and the --profile file; false if that cannot be written
+static bool reportProfile(ARAPProfile& profile, const ARAPBatchOptions& options)
+{
+	profile.set("peak_rss_mb", peakMemoryMB());
+	std::cout << profile.summary() << std::endl;
+	std::cout << "peak RSS: " << profile.counter("peak_rss_mb") << " MB" << std::endl;
+	return options.profile.empty() || profile.write(options.profile);
+}
+
+// handle file for the vertices of a surface mesh: the tet and barycentrics of every
+// rest vertex, and one frame per deformed copy of the surface
+static bool locateControlPoints(const std::string& tetFile, const std::string& surfaceFile, const std::string& outputFile,
+	const std::vector<std::string>& deformedFiles)
+{
+	std::vector<Eigen::Vector3d> verts, surface;
+	std::vector<Eigen::Vector4i> tets;
+	if (!readTetMesh(tetFile, verts, tets) || !readObjVertices(surfaceFile, surface)) return false;
+	auto t0 = std::chrono::steady_clock::now();
+	TetLocator locator(verts, tets);
+	const double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	t0 = std::chrono::steady_clock::now();
+	std::vector<TetLocation> locations;
+	locator.locate(surface, locations);
+	const double locateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+	std::vector<Eigen::Vector4i> bary_vert_index(surface.size());
+	std::vector<Eigen::Vector4d> barycentric(surface.size());
+	int outside = 0;
+	double maxDistance = 0;
+	for (int i = 0; i < surface.size(); i++)
+	{
+		if (locations[i].tet < 0)
+		{
+			std::cerr << "Error: " << tetFile << " has no tets" << std::endl;
+			return false;
+		}
+		bary_vert_index[i] = locator.tet(locations[i].tet);
+		barycentric[i] = locations[i].barycentric;
+		outside += !locations[i].inside;
+		maxDistance = std::max(maxDistance, locations[i].distance);
+	}
+	std::cout << "located " << surface.size() << " points in " << tets.size() << " tets: BVH depth " << locator.depth()
+		<< ", build " << buildMs << " ms, queries " << locateMs << " ms; " << outside << " outside (nearest tet, max distance "
+		<< maxDistance << ")" << std::endl;
+
+	std::vector<std::vector<Eigen::Vector3d>> seq_constPoint(deformedFiles.size());
+	for (int k = 0; k < deformedFiles.size(); k++)
+	{
+		if (!readObjVertices(deformedFiles[k], seq_constPoint[k])) return false;
+	}
+	const bool binary = outputFile.size() > 4 && outputFile.compare(outputFile.size() - 4, 4, ".bin") == 0;
+	if (binary) return writeBinaryHandleFile(outputFile, seq_constPoint, bary_vert_index, barycentric);
+	return writeTextHandleFile(outputFile, seq_constPoint, bary_vert_index, barycentric);
+}
+
 int main(int argc, char *argv[])
 {
-	if (argc == 5)
+	if (argc >= 3 && std::string(argv[1]) == "--check-weights")
+	{
+		// weight diagnostics only, no solve: exit code 2 if the cage has degenerate tets or unusable weights
+		ARAPBatchOptions options;
+		for (int i = 3; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if (!parseIterationOption(argc, argv, i, options))
+			{
+				std::cerr << "invalid option " << arg << std::endl;
+				return 1;
+			}
+		}
+		TetrahedralMesh meshOri;
+		if (!myReadFile(argv[2], meshOri)) return 1;
+		ARAPDeform arapDeform(meshOri, false, options.weights);
+		std::cout << arapDeform.weightReport.summary() << std::endl;
+		if (!options.weightReport.empty() && !arapDeform.weightReport.write(options.weightReport)) return 1;
+		return arapDeform.weightReport.ok() ? 0 : 2;
+	}
+	else if (argc >= 5 && std::string(argv[1]) == "--locate")
+	{
+		// control points for the vertices of a surface inside the tet mesh, replacing the brute-force search
+		// of barycentric_control_pts_jittor.py
+		std::vector<std::string> deformedFiles(argv + 5, argv + argc);
+		return locateControlPoints(argv[2], argv[3], argv[4], deformedFiles) ? 0 : 1;
+	}
+	else if (argc == 4 && std::string(argv[1]) == "--convert-handles")
+	{
+		// text handle file -> memory-mappable binary handle file
+		return convertHandleFile(argv[2], argv[3]) ? 0 : 1;
+	}
+	else if (argc >= 7 && std::string(argv[1]) == "--batch")
+	{
+		// one mesh, one factorization per control block, many handle files on a thread pool
+		std::string inputObj = argv[2];
+		std::string outputFolder = argv[3];
+		ARAPBatchOptions options;
+		options.hardConstrain = atoi(argv[4]);
+		options.numThreads = atoi(argv[5]);
+		std::vector<std::string> handleFiles;
+		for (int i = 6; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if (arg == "--independent-frames") options.independentFrames = true;
+			else if (!parseIterationOption(argc, argv, i, options))
+			{
+				if (arg.compare(0, 2, "--") == 0)
+				{
+					std::cerr << "invalid option " << arg << std::endl;
+					return 1;
+				}
+				handleFiles.push_back(arg);
+			}
+		}
+		ARAPProfile profile;
+		TetrahedralMesh meshOri;
+		ARAPPhaseTimer loadTimer(&profile, ARAP_PHASE_LOAD);
+		if (!myReadFile(inputObj.c_str(), meshOri)) return 1;
+		loadTimer.stop();
+		int failed = runARAPBatch(meshOri, handleFiles, outputFolder, options, &profile);
+		const bool profiled = reportProfile(profile, options);
+		return failed == 0 && profiled ? 0 : 1;
+	}
+	else if (argc >= 5)
 	{
 		std::string inputObj = argv[1];
 		std::string handleFile = argv[2];
 		std::string outputFolder = argv[3];
 		bool hardConstrain = atoi(argv[4]);
+		ARAPBatchOptions options;
+		int levels = 0, fineIterTime = 2, roiRings = -1;
+		double coarsening = 2.0, roiRadius = 0;
+		for (int i = 5; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if (arg == "--levels" && i + 1 < argc) levels = atoi(argv[++i]);
+			else if (arg == "--fine-iter" && i + 1 < argc) fineIterTime = atoi(argv[++i]);
+			else if (arg == "--coarsening" && i + 1 < argc) coarsening = atof(argv[++i]);
+			else if (arg == "--roi-rings" && i + 1 < argc) roiRings = atoi(argv[++i]);
+			else if (arg == "--roi-radius" && i + 1 < argc) roiRadius = atof(argv[++i]);
+			else if (!parseIterationOption(argc, argv, i, options))
+			{
+				std::cerr << "invalid option " << arg << std::endl;
+				return 1;
+			}
+		}
+		ARAPProfile profile;
 		TetrahedralMesh meshOri;
+		ARAPPhaseTimer loadTimer(&profile, ARAP_PHASE_LOAD);
 		myReadFile(inputObj.c_str(), meshOri);
+		loadTimer.stop();
 		std::string outputName = "test_output.ovm";
 		myWriteFile(outputName, meshOri);
-		ARAPDeform *arapDeform = new ARAPDeform(meshOri, hardConstrain);
-		arapDeform->yyj_ARAPDeform(handleFile, outputFolder);
+		ARAPPhaseTimer weightTimer(&profile, ARAP_PHASE_WEIGHTS);
+		ARAPDeform *arapDeform = new ARAPDeform(meshOri, hardConstrain, options.weights);
+		weightTimer.stop();
+		arapDeform->profile = &profile;
+		if (!options.weightReport.empty()) arapDeform->weightReport.write(options.weightReport);
+		arapDeform->maxIterTime = options.maxIterTime;
+		arapDeform->tolerance = options.tolerance;
+		arapDeform->convergence = options.convergence;
+		arapDeform->andersonWindow = options.andersonWindow;
+		arapDeform->warmStart = options.warmStart;
+		arapDeform->outputFormat = options.outputFormat;
+		arapDeform->solver.backendType = options.solverBackend;
+		arapDeform->solver.pcg = options.cg;
+		arapDeform->matrixFree = options.matrixFree;
+		arapDeform->matrixFreeSolver.options = options.cg;
+		arapDeform->mixedPrecision = options.mixedPrecision;
+		arapDeform->rotationKernel = options.rotationKernel;
+		arapDeform->solver.refinementSteps = options.refinementSteps;
+		bool ok;
+		if (levels > 0)
+		{
+			// coarse-to-fine: --max-iter bounds every coarse level, --fine-iter the fine mesh
+			ARAPHierarchy hierarchy(*arapDeform, levels, coarsening);
+			hierarchy.coarseIterTime = options.maxIterTime;
+			hierarchy.fineIterTime = fineIterTime;
+			ok = hierarchy.yyj_ARAPDeform(handleFile, outputFolder);
+		}
+		else if (roiRings >= 0 || roiRadius > 0)
+		{
+			// solve only around the controls, the rest of the mesh stays where it is
+			ARAPRegion region(*arapDeform, std::max(roiRings, 0), roiRadius);
+			ok = region.yyj_ARAPDeform(handleFile, outputFolder);
+		}
+		else
+		{
+			ok = arapDeform->yyj_ARAPDeform(handleFile, outputFolder);
+		}
+		const bool profiled = reportProfile(profile, options);
+		if (!ok || !profiled) return 1;
 	}
 	else
 	{
-		std::cout << "exe inputObj handleFile outputFolder hardConstrain" << std::endl;
+		std::cout << "exe inputObj handleFile outputFolder hardConstrain [iteration options]" << std::endl;
+		std::cout << "exe --batch inputObj outputFolder hardConstrain numThreads [--independent-frames] [iteration options] handleFile..." << std::endl;
+		std::cout << "exe --convert-handles handleFile.txt handleFile.bin" << std::endl;
+		std::cout << "exe --locate tetmesh surface.obj handles(.txt|.bin) [deformed.obj...]" << std::endl;
+		std::cout << "exe --check-weights inputObj [weight options]" << std::endl;
+		std::cout << "handle files may be text or binary (see --convert-handles)" << std::endl;
+		std::cout << "hierarchical options (single mode): --levels n, --fine-iter k, --coarsening c" << std::endl;
+		std::cout << "region of interest (single mode): --roi-rings k or --roi-radius r around the control tets, the ring outside is pinned" << std::endl;
+		std::cout << "iteration options: --max-iter n, --tol x, --energy, --anderson window, --no-warm-start" << std::endl;
+		std::cout << "weight options: --max-weight x, --min-weight x, --degenerate-quality q, --weight-report file.json" << std::endl;
+		std::string backends;
+		for (ARAPSolverBackend b : availableSolverBackends()) backends += std::string(backends.empty() ? "" : "|") + solverBackendName(b);
+		std::cout << "solver options: --solver " << backends << " (pcg: incomplete Cholesky preconditioned CG, warm-started)," << std::endl;
+		std::cout << "  --matrix-free (Jacobi-preconditioned CG without assembling A^T*A, soft constraints only), --cg-tol x, --cg-max-iter n" << std::endl;
+		std::cout << "precision options: --mixed-precision (float local step and rhs, double factor), --refine n (iterative refinement steps of the global solve)" << std::endl;
+		std::string kernels;
+		for (ARAPRotationKernel k : availableRotationKernels()) kernels += std::string(kernels.empty() ? "" : "|") + rotationKernelName(k);
+		std::cout << "local step options: --rotation-kernel " << kernels << " (default: " << rotationKernelName(detectRotationKernel()) << ")" << std::endl;
+		std::cout << "profile: --profile run.json (phases, counters, frames) or --profile runs.csv (one row appended per run)" << std::endl;
+		std::cout << "output options: --output ovm|positions|deltas (positions/deltas: arap_topology.ovm + float32 arap_frames.bin)" << std::endl;
 	}
 
 	return 0;
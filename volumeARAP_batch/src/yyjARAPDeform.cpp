@@ -1,6 +1,13 @@
 #include <Eigen/SVD>
 #include <omp.h>
+#include <array>
+#include <cmath>
+#include <chrono>
 #include <ctime>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sstream>
 #include "ARAPDeform.h"
 
 using namespace std;
@@ -37,97 +44,209 @@ Eigen::Matrix3d vec2mat(Eigen::Vector3d a, Eigen::Vector3d b) {
 	return resultMat;
 }
 
-double calDihedralAngle(std::vector<OpenVolumeMesh::Geometry::Vec3d> dihedral) {
-    // v1, v2 constructs the common edge. v3 and v4 expand the dihedral angle
-    OpenVolumeMesh::Geometry::Vec3d v1 = dihedral[0];
-    OpenVolumeMesh::Geometry::Vec3d v2 = dihedral[1];
-    OpenVolumeMesh::Geometry::Vec3d v3 = dihedral[2];
-    OpenVolumeMesh::Geometry::Vec3d v4 = dihedral[3];
+// Cotangents of the six interior dihedral angles of tet p[0..3]. cot[e] belongs to the
+// vertex pair tetEdges[e] and is the cotangent at the opposite edge, which is the ARAP
+// weight contribution of this tet to edge tetEdges[e]. With C_i = det * grad(lambda_i)
+// (the cross products below, |C_i| = 2 * area of the face opposite i), the dihedral
+// angle at edge (k, l) between the faces opposite i and j has
+// cot = -C_i.C_j / (|det| * |p_k - p_l|), independent of the tet's orientation.
+// Returns the tet quality sqrt(2) * |det| / rms edge length^3, 1 for a regular tet;
+// the cotangents are inf/NaN when it is 0.
+static const int tetEdges[6][2] = { { 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
 
-    // assume the order: v3 -> v1 -> v2 -> v4
-    OpenVolumeMesh::Geometry::Vec3d d1 = v1 - v3;
-    OpenVolumeMesh::Geometry::Vec3d d2 = v2 - v1;
-    OpenVolumeMesh::Geometry::Vec3d d3 = v4 - v2;
+static double tetDihedralCotangents(const Eigen::Vector3d p[4], double cot[6])
+{
+	const Eigen::Vector3d e1 = p[1] - p[0], e2 = p[2] - p[0], e3 = p[3] - p[0];
+	Eigen::Vector3d C[4];
+	C[1] = e2.cross(e3);
+	C[2] = e3.cross(e1);
+	C[3] = e1.cross(e2);
+	C[0] = -(C[1] + C[2] + C[3]);
+	const double absDet = std::abs(e1.dot(C[1]));
+	double squaredLengths = 0;
+	for (int e = 0; e < 6; e++)
+	{
+		const int i = tetEdges[e][0], j = tetEdges[e][1];
+		const int k = tetEdges[5 - e][0], l = tetEdges[5 - e][1];  // the opposite edge
+		const double length = (p[k] - p[l]).norm();
+		cot[e] = -C[i].dot(C[j]) / (absDet * length);
+		squaredLengths += length * length;
+	}
+	const double rms = std::sqrt(squaredLengths / 6);
+	return rms > 0 ? std::sqrt(2.0) * absDet / (rms * rms * rms) : 0;
+}
 
-    OpenVolumeMesh::Geometry::Vec3d n1 = d1.cross(d2);
-    OpenVolumeMesh::Geometry::Vec3d n2 = d2.cross(d3);
+ARAPDeform::ARAPDeform(TetrahedralMesh& input_mesh, bool hardConstrain, const ARAPWeightOptions& weightOptions) :mesh(&input_mesh)
+{
+	// flat CSR snapshot of the vertex-vertex adjacency. Neighbour ids and rest edges are
+	// recorded from the same outgoing half-edge walk, so their orders agree by construction
+	const int n_vertices = (int)input_mesh.n_vertices();
+	adjacency.offsets.resize(n_vertices + 1, 0);
+	adjacency.neighbors.reserve(input_mesh.n_halfedges());
+	adjacency.rest_edges.reserve(input_mesh.n_halfedges());
+	std::vector<Eigen::Vector3d> rest(n_vertices);
+	for (int i = 0; i < n_vertices; i++) rest[i] = OVtoE(input_mesh.vertex(VertexHandle(i)));
+	for (int i = 0; i < n_vertices; i++)
+	{
+		adjacency.offsets[i] = (int)adjacency.neighbors.size();
+		for (OpenVolumeMesh::VertexOHalfEdgeIter voheit = input_mesh.voh_iter(VertexHandle(i)); voheit.valid(); voheit++) {
+			int j = input_mesh.to_vertex_handle(*voheit).idx();
+			adjacency.neighbors.push_back(j);
+			adjacency.rest_edges.push_back(rest[i] - rest[j]);
+		}
+	}
+	adjacency.offsets[n_vertices] = (int)adjacency.neighbors.size();
 
-    double cos_angle = n1.dot(n2) / n1.norm() / n2.norm();
+	// tets as vertex quadruples, and the tets around every vertex (CSR)
+	const int n_cells = (int)input_mesh.n_cells();
+	std::vector<Eigen::Vector4i> cells(n_cells);
+	std::vector<int> cellOffsets(n_vertices + 1, 0);
+	for (int c = 0; c < n_cells; c++)
+	{
+		int m = 0;
+		for (OpenVolumeMesh::CellVertexIter cvit = input_mesh.cv_iter(OpenVolumeMesh::CellHandle(c)); cvit.valid() && m < 4; cvit++) {
+			cells[c][m++] = cvit->idx();
+			cellOffsets[cvit->idx() + 1]++;
+		}
+	}
+	for (int i = 0; i < n_vertices; i++) cellOffsets[i + 1] += cellOffsets[i];
+	std::vector<int> vertexCells(cellOffsets[n_vertices]);
+	{
+		std::vector<int> fill(cellOffsets.begin(), cellOffsets.end() - 1);
+		for (int c = 0; c < n_cells; c++)
+			for (int m = 0; m < 4; m++) vertexCells[fill[cells[c][m]]++] = c;
+	}
 
-    return cos_angle / sqrt(1 - cos_angle*cos_angle);
-}
+	// six dihedral cotangents per tet, computed once; degenerate tets are left out
+	std::vector<std::array<double, 6>> cellCot(n_cells);
+	std::vector<double> cellQuality(n_cells);
+	std::vector<char> cellValid(n_cells);
+#pragma omp parallel for schedule(static)
+	for (int c = 0; c < n_cells; c++)
+	{
+		Eigen::Vector3d p[4];
+		for (int m = 0; m < 4; m++) p[m] = rest[cells[c][m]];
+		cellQuality[c] = tetDihedralCotangents(p, cellCot[c].data());
+		bool valid = cellQuality[c] >= weightOptions.degenerateQuality;
+		for (int e = 0; e < 6; e++) valid = valid && std::isfinite(cellCot[c][e]);
+		cellValid[c] = valid;
+	}
 
-ARAPDeform::ARAPDeform(TetrahedralMesh& input_mesh, bool hardConstrain) :mesh(&input_mesh)
-{
-	degree.resize(input_mesh.n_vertices(), 0);
-	edge_index.resize(input_mesh.n_vertices(), 0);
-	half_edge_num = 0;
-	for (int i = 0; i < input_mesh.n_vertices(); i++)
+	// every vertex gathers the cotangents of its own half-edges: the weight of (i, j) is the
+	// mean over the tets around edge (i, j) of the cotangent at the edge opposite in that tet
+	adjacency.weights.assign(adjacency.n_half_edges(), 0.0);
+#pragma omp parallel
 	{
-		VertexHandle vi(i);
-		std::vector<Tet_vec3d> neighborPoints;
-		Tet_vec3d pi = input_mesh.vertex(vi);
+		std::vector<int> count;  // tets seen per half-edge of the current vertex
+#pragma omp for schedule(dynamic, 256)
+		for (int i = 0; i < n_vertices; i++)
+		{
+			const int begin = adjacency.offsets[i], end = adjacency.offsets[i + 1];
+			count.assign(end - begin, 0);
+			for (int k = cellOffsets[i]; k < cellOffsets[i + 1]; k++)
+			{
+				if (!cellValid[vertexCells[k]]) continue;
+				const Eigen::Vector4i& t = cells[vertexCells[k]];
+				for (int e = 0; e < 6; e++)
+				{
+					int j;
+					if (t[tetEdges[e][0]] == i) j = t[tetEdges[e][1]];
+					else if (t[tetEdges[e][1]] == i) j = t[tetEdges[e][0]];
+					else continue;
+					for (int h = begin; h < end; h++)
+					{
+						if (adjacency.neighbors[h] == j)
+						{
+							adjacency.weights[h] += cellCot[vertexCells[k]][e];
+							count[h - begin]++;
+							break;
+						}
+					}
+				}
+			}
+			for (int h = begin; h < end; h++)
+			{
+				adjacency.weights[h] = count[h - begin] > 0 ? adjacency.weights[h] / count[h - begin] : std::numeric_limits<double>::quiet_NaN();
+			}
+		}
+	}
 
-		edge_index[i] = half_edge_num;
-		for (OpenVolumeMesh::VertexVertexIter vv_it = input_mesh.vv_iter(vi); vv_it.valid(); ++vv_it)
+	// replace missing and non-finite weights, clamp the rest. Both half-edges of an edge hold
+	// the same mean (their tets are gathered in the same order), so they get the same weight
+	weightReport = ARAPWeightReport();
+	weightReport.n_vertices = n_vertices;
+	weightReport.n_tets = n_cells;
+	weightReport.n_edges = adjacency.n_half_edges() / 2;
+	for (int c = 0; c < n_cells; c++)
+	{
+		if (!cellValid[c]) weightReport.degenerateCells.push_back({ c, cells[c], cellQuality[c] });
+	}
+	double fallback = 0;
+	int n_finite = 0;
+	for (double w : adjacency.weights)
+	{
+		if (std::isfinite(w))
 		{
-			int j = vv_it->idx();
-			neighborPoints.push_back(input_mesh.vertex(VertexHandle(j)));
-			half_edge_num++;
-			degree[i]++;
+			fallback += std::abs(w);
+			n_finite++;
 		}
-		
-
-		int neighborsNum = (int)neighborPoints.size();
-
-		std::vector<double> weights(neighborsNum, 0);
-
-		// calculate e dihedral angles
-		int cnt = 0;
-        for (OpenVolumeMesh::VertexOHalfEdgeIter voheit=input_mesh.voh_iter(vi); voheit.valid(); voheit++) {
-            OpenVolumeMesh::VertexHandle vi2 = input_mesh.to_vertex_handle(*voheit);
-            // std::cout << "****** the edge between ****** " << vi.idx() << " and " << vi2.idx() << std::endl;
-			int cell_num = 0;
-            OpenVolumeMesh::EdgeHandle eh = input_mesh.edge_handle(*voheit);
-            for (OpenVolumeMesh::EdgeCellIter ecit=input_mesh.ec_iter(eh); ecit.valid(); ecit++) {
-                // std::cout << "iterate cells ..." << std::endl;
-                std::vector<OpenVolumeMesh::Geometry::Vec3d> dihedralAngle;
-                // vector size is 4. The first and second is the common edge
-                for (OpenVolumeMesh::CellVertexIter cvit=input_mesh.cv_iter(*ecit); cvit.valid(); cvit++) {
-                    if (*cvit != vi && *cvit != vi2) {
-                        dihedralAngle.push_back(input_mesh.vertex(*cvit));
-                        // std::cout << "verts add " << (*cvit).idx() << std::endl;
-                    }
-                }
-                dihedralAngle.push_back(input_mesh.vertex(vi));
-                dihedralAngle.push_back(input_mesh.vertex(vi2));
-                // std::cout << "specific verts are: " << vi.idx() << ", " << vi2.idx() << std::endl;
-				cell_num++;
-				weights[cnt] += calDihedralAngle(dihedralAngle);
-                // std::cout << "the cot of dihedralAngle is: " << calDihedralAngle(dihedralAngle) << std::endl;
-            }
-			weights[cnt] /= cell_num; cnt++;
-        }
-		assert(cnt == neighborsNum);
-
-		for (int neighborCounts = 0; neighborCounts < neighborsNum; neighborCounts++)
+	}
+	fallback = n_finite > 0 && fallback > 0 ? fallback / n_finite : 1.0;
+	weightReport.minWeight = std::numeric_limits<double>::max();
+	weightReport.maxWeight = -std::numeric_limits<double>::max();
+	for (int i = 0; i < n_vertices; i++)
+	{
+		for (int h = adjacency.offsets[i]; h < adjacency.offsets[i + 1]; h++)
 		{
-			Tet_vec3d edgeij_tet = pi - neighborPoints[neighborCounts];
-			Eigen::Vector3d edgeij = OVtoE(edgeij_tet);
-			this->edgeijs.push_back(edgeij);
-
-			/*double w1 = yyj_cotan(OVtoE(pi - neighborPoints[(neighborCounts + neighborsNum - 1) % neighborsNum]), OVtoE(neighborPoints[neighborCounts] - neighborPoints[(neighborCounts + neighborsNum - 1) % neighborsNum]));
-			double w2 = yyj_cotan(OVtoE(pi - neighborPoints[(neighborCounts + 1) % neighborsNum]), OVtoE(neighborPoints[neighborCounts] - neighborPoints[(neighborCounts + 1) % neighborsNum]));
-			weights[neighborCounts] = 0.5*(w1 + w2);*/
-			// weights[neighborCounts] = 1;
-			/*if ((weights[neighborCounts] != weights[neighborCounts]) || weights[neighborCounts] > 100000 || abs(weights[neighborCounts]) < Eps)
+			const double raw = adjacency.weights[h];
+			double w = raw;
+			const char* reason = nullptr;
+			if (std::isnan(raw))
 			{
-
-			}*/
-			edge_weights.push_back(weights[neighborCounts]);
+				w = fallback;
+				reason = "no valid tet";
+			}
+			else if (!std::isfinite(raw))
+			{
+				w = fallback;
+				reason = "non-finite";
+			}
+			else if (std::abs(raw) > weightOptions.maxWeight)
+			{
+				w = raw > 0 ? weightOptions.maxWeight : -weightOptions.maxWeight;
+				reason = "clamped";
+			}
+			if (weightOptions.enforcePositive && w < weightOptions.minWeight)
+			{
+				w = weightOptions.minWeight;
+				if (reason == nullptr) reason = "raised to minimum";
+			}
+			adjacency.weights[h] = w;
+			weightReport.minWeight = std::min(weightReport.minWeight, w);
+			weightReport.maxWeight = std::max(weightReport.maxWeight, w);
+			if (reason != nullptr && i < adjacency.neighbors[h])
+			{
+				weightReport.edges.push_back({ i, adjacency.neighbors[h], raw, w, reason });
+			}
 		}
 	}
+	if (adjacency.n_half_edges() == 0) weightReport.minWeight = weightReport.maxWeight = 0;
+	if (!weightReport.degenerateCells.empty() || !weightReport.edges.empty())
+	{
+		std::cout << weightReport.summary() << std::endl;
+	}
 
+	this->init(hardConstrain);
+}
+
+ARAPDeform::ARAPDeform(TetrahedralMesh& input_mesh, const ARAPAdjacency& input_adjacency, bool hardConstrain) :mesh(&input_mesh), adjacency(input_adjacency)
+{
+	this->init(hardConstrain);
+}
+
+void ARAPDeform::init(bool hardConstrain)
+{
+	const TetrahedralMesh& input_mesh = *this->mesh;
 	isConst.resize(input_mesh.n_vertices(), false);
 	isConst_i.resize(input_mesh.n_vertices(), 0);
 	//constPoint.resize(input_mesh.n_vertices(), Eigen::Vector3d(0, 0, 0));
@@ -147,8 +266,29 @@ ARAPDeform::ARAPDeform(TetrahedralMesh& input_mesh, bool hardConstrain) :mesh(&i
 	this->resultX = NULL;
 
 	maxIterTime = 10;
+	tolerance = 1e-4;
+	convergence = ARAP_MAX_DISPLACEMENT;
+	andersonWindow = 0;
+	warmStart = true;
 	this->hardConstrain = hardConstrain;
+	this->separateAxes = true;
+	matrixFree = false;
+	maxLowRankTerms = 256;
+	mixedPrecision = false;
+	rotationKernel = detectRotationKernel();
+	profile = nullptr;
+	outputFormat = ARAP_OUTPUT_OVM;
 
+	Eigen::Vector3d bbMin = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+	Eigen::Vector3d bbMax = -bbMin;
+	for (int i = 0; i < input_mesh.n_vertices(); i++)
+	{
+		Eigen::Vector3d p = OVtoE(input_mesh.vertex(VertexHandle(i)));
+		bbMin = bbMin.cwiseMin(p);
+		bbMax = bbMax.cwiseMax(p);
+	}
+	bbox_diagonal = input_mesh.n_vertices() > 0 ? (bbMax - bbMin).norm() : 1.0;
+	if (bbox_diagonal <= 0) bbox_diagonal = 1.0;
 }
 
 void ARAPDeform::setConstPoint(int i, Eigen::Vector3d v) {
@@ -158,7 +298,8 @@ void ARAPDeform::setConstPoint(int i, Eigen::Vector3d v) {
 	seq_constPoint[i].push_back(v);
 }
 
-void ARAPDeform::loadConstPoint(std::istream& cin) {
+bool readConstPoint(std::istream& cin, std::vector<std::vector<Eigen::Vector3d>>& seq_constPoint,
+	std::vector<Eigen::Vector4i>& bary_vert_index, std::vector<Eigen::Vector4d>& barycentric) {
 	int n;
 	cin >> n; // sequence³¤¶È
 	seq_constPoint.resize(n);
@@ -166,11 +307,11 @@ void ARAPDeform::loadConstPoint(std::istream& cin) {
 		int m; // Ã¿¸ö¿ØÖÆµã¸öÊý
 		cin >> m;
 		std::cout << "loading " << m << " control points\n";
-		std::vector<int> ids(m);
+		seq_constPoint[i].reserve(m);
 		for (int j = 0; j < m; j++) {
 			double x, y, z;
 			cin >> x >> y >> z;
-			this->setConstPoint(i, Eigen::Vector3d(x, y, z));
+			seq_constPoint[i].push_back(Eigen::Vector3d(x, y, z));
 		}
 	}
 	// add barycentric as constrain
@@ -181,6 +322,23 @@ void ARAPDeform::loadConstPoint(std::istream& cin) {
 		bary_vert_index.push_back(Eigen::Vector4i(v1, v2, v3, v4));
 		cin >> u >> v >> w >> z;
 		barycentric.push_back(Eigen::Vector4d(u, v, w, z));
+	}
+	return !cin.fail();
+}
+
+void ARAPDeform::loadConstPoint(std::istream& cin) {
+	std::vector<Eigen::Vector4i> tets;
+	std::vector<Eigen::Vector4d> barys;
+	readConstPoint(cin, seq_constPoint, tets, barys);
+	this->set_controls(tets, barys);
+}
+
+void ARAPDeform::set_controls(const std::vector<Eigen::Vector4i>& tets, const std::vector<Eigen::Vector4d>& barys) {
+	for (int i = 0; i < tets.size(); i++) {
+		int v1 = tets[i][0], v2 = tets[i][1], v3 = tets[i][2], v4 = tets[i][3];
+		double u = barys[i][0], v = barys[i][1], w = barys[i][2], z = barys[i][3];
+		bary_vert_index.push_back(tets[i]);
+		barycentric.push_back(barys[i]);
 		control_index[v1].push_back(i);
 		control_index[v2].push_back(i);
 		control_index[v3].push_back(i);
@@ -189,6 +347,7 @@ void ARAPDeform::loadConstPoint(std::istream& cin) {
 		control_weight[v2].push_back(v);
 		control_weight[v3].push_back(w);
 		control_weight[v4].push_back(z);
+		this->controlpoint_number.push_back(make_pair(i, Eigen::Vector3d(0, 0, 0))); // ¿ØÖÆµã(ÖØÐÄ×ø±ê)ÊýÄ¿
 	}
 }
 
@@ -206,9 +365,9 @@ void ARAPDeform::global_step_pre(TetrahedralMesh& deformedMesh)
 	int m = 0;
 	for (int i = 0; i < mesh->n_vertices(); i++)
 	{
-		m += 3 * this->degree[i];
+		m += 3 * adjacency.degree(i);
 	}
-	//cout << mesh->n_edges() << " " << 3 * half_edge_num;
+	//cout << mesh->n_edges() << " " << 3 * adjacency.n_half_edges();
 	//m += this->controlpoint_number.size() * 3;
 	int row_num = m + this->controlpoint_number.size() * 3;
 	if (this->AcsrRowIndPtr == NULL)
@@ -227,7 +386,7 @@ void ARAPDeform::global_step_pre(TetrahedralMesh& deformedMesh)
 		int n = 0;
 		for (int i = 0; i < control_index.size(); i++)
 		{
-			n += 3 * this->degree[i] * control_index[i].size();
+			n += 3 * adjacency.degree(i) * control_index[i].size();
 		}
 		ele_num = m * 2 + this->controlpoint_number.size() * 3 * 4 + n;
 	}
@@ -262,10 +421,9 @@ void ARAPDeform::global_step_pre(TetrahedralMesh& deformedMesh)
 	// Deformation Term //set rowIndPtr and colPtr for Matrix A in Ax=b
 	for (int i = 0; i < mesh->n_vertices(); i++)   //base energy item
 	{
-		VertexHandle vi(i);
-		for (OpenVolumeMesh::VertexVertexIter vj = deformedMesh.vv_iter(vi); vj; vj++)
+		for (int edgeijIndex = adjacency.offsets[i]; edgeijIndex < adjacency.offsets[i + 1]; edgeijIndex++)
 		{
-			int j = vj->idx();
+			int j = adjacency.neighbors[edgeijIndex];
 			for (int index = 0; index < 3; index++)//x,y,z,3 axis
 			{
 				int handlePointCounter = 0;
@@ -346,12 +504,11 @@ void ARAPDeform::global_step_pre(TetrahedralMesh& deformedMesh)
 		//modify ±È½ÏÀ÷º¦µÄr
 		//Eigen::Matrix3d &ri = this->featurevector_result.rots[i].r;
 		//Eigen::Matrix3d &ri = R[i];
-		int edgeijIndex = this->edge_index[i];//first neighbour edge index
-											  //iterate point j (i adjacent points)
-		for (OpenVolumeMesh::VertexVertexIter vj = deformedMesh.vv_iter(vi); vj; vj++)
+		//iterate point j (i adjacent points)
+		for (int edgeijIndex = adjacency.offsets[i]; edgeijIndex < adjacency.offsets[i + 1]; edgeijIndex++)
 		{
-			int j = vj->idx();
-			double lambdaDeformWeightCiCij = 1.0 * (this->edge_weights[edgeijIndex]);
+			int j = adjacency.neighbors[edgeijIndex];
+			double lambdaDeformWeightCiCij = 1.0 * (adjacency.weights[edgeijIndex]);
 			for (int axis = 0; axis < 3; axis++)//x,y,z
 			{
 				//Point parameter
@@ -384,7 +541,6 @@ void ARAPDeform::global_step_pre(TetrahedralMesh& deformedMesh)
 					}
 				}
 			}//end of xyz
-			edgeijIndex++;
 		}//end of j
 	}//end of i
 
@@ -404,6 +560,7 @@ void ARAPDeform::global_step_pre(TetrahedralMesh& deformedMesh)
 
 void ARAPDeform::eigen_global_step_pre(TetrahedralMesh& deformedMesh)
 {
+	int half_edge_num = adjacency.n_half_edges();
 	int row_num = (half_edge_num + this->controlpoint_number.size()) * 3;
 
 	int ele_num;
@@ -416,13 +573,12 @@ void ARAPDeform::eigen_global_step_pre(TetrahedralMesh& deformedMesh)
 		int n = 0;
 		for (int i = 0; i < control_index.size(); i++)
 		{
-			n += 3 * this->degree[i] * control_index[i].size();
+			n += 3 * adjacency.degree(i) * control_index[i].size();
 		}
 		ele_num = half_edge_num * 3 * 2 + this->controlpoint_number.size() * 3 * 4 + n;
 	}
 	this->tripletList.reserve(ele_num);
 	this->vectorBSize = row_num;
-	this->vectorBPtr = (double *)malloc(vectorBSize * sizeof(double));
 
 	int rowCounter = 0;
 	int axisNum = 3;
@@ -430,12 +586,10 @@ void ARAPDeform::eigen_global_step_pre(TetrahedralMesh& deformedMesh)
 	// Deformation Term //set rowIndPtr and colPtr for Matrix A in Ax=b
 	for (int i = 0; i < mesh->n_vertices(); i++)   //base energy item
 	{
-		VertexHandle vi(i);
-		int edgeijIndex = this->edge_index[i];//first neighbour edge index
-		for (OpenVolumeMesh::VertexVertexIter vj = deformedMesh.vv_iter(vi); vj; vj++)
+		for (int edgeijIndex = adjacency.offsets[i]; edgeijIndex < adjacency.offsets[i + 1]; edgeijIndex++)
 		{
-			int j = vj->idx();
-			double lambdaDeformWeightCiCij = 1.0 * (this->edge_weights[edgeijIndex]);
+			int j = adjacency.neighbors[edgeijIndex];
+			double lambdaDeformWeightCiCij = 1.0 * (adjacency.weights[edgeijIndex]);
 			for (int index = 0; index < axisNum; index++)//x,y,z,3 axis
 			{
 				int handlePointCounter = 0;
@@ -467,7 +621,6 @@ void ARAPDeform::eigen_global_step_pre(TetrahedralMesh& deformedMesh)
 					}
 				}
 			}//end of xyz
-			edgeijIndex++;
 			rowCounter += axisNum;
 		}//end of vj
 	}//end of vi
@@ -487,183 +640,561 @@ void ARAPDeform::eigen_global_step_pre(TetrahedralMesh& deformedMesh)
 	}
 }
 
-void ARAPDeform::local_step(std::vector<Eigen::Matrix3d>& R, TetrahedralMesh& deformedMesh)
+void ARAPDeform::eigen_global_step_pre_axis()
 {
-	std::cout << "Local Step" << endl;
-	//OMP_open
-	for (int i = 0, edgeCounter = 0; i < mesh->n_vertices(); i++)
+	// x, y and z rows of the interleaved system are identical and decoupled without
+	// hard constraints, so A is built once on the |V| scalar unknowns
+	this->tripletList.reserve(adjacency.n_half_edges() * 2 + this->controlpoint_number.size() * 4);
+
+	int rowCounter = 0;
+	for (int i = 0; i < mesh->n_vertices(); i++)
 	{
-		Eigen::Matrix3d edgeMatrixSum = Eigen::Matrix3d::Zero();
-		VertexHandle vi(i);
-		for (OpenVolumeMesh::VertexVertexIter vj = deformedMesh.vv_iter(vi); vj; vj++)
+		for (int edgeijIndex = adjacency.offsets[i]; edgeijIndex < adjacency.offsets[i + 1]; edgeijIndex++)
 		{
-			int j = vj->idx();
-			Eigen::Vector3d deformedEdgeij = OVtoE(deformedMesh.vertex(vi) - deformedMesh.vertex(VertexHandle(j)));
-			//edgeMatrixSum += edge_weights[edgeCounter] * vec2mat(edgeijs[edgeCounter], deformedEdgeij);
-			edgeMatrixSum += vec2mat(edgeijs[edgeCounter], deformedEdgeij);
-			edgeCounter++;
+			int j = adjacency.neighbors[edgeijIndex];
+			double lambdaDeformWeightCiCij = adjacency.weights[edgeijIndex];
+			tripletList.push_back(Tri(rowCounter, i, lambdaDeformWeightCiCij));
+			tripletList.push_back(Tri(rowCounter, j, -lambdaDeformWeightCiCij));
+			rowCounter++;
 		}
-		Eigen::JacobiSVD<Eigen::MatrixXd> svd(edgeMatrixSum, Eigen::ComputeThinU | Eigen::ComputeThinV);
-		Eigen::MatrixXd U = svd.matrixU();
-		Eigen::MatrixXd V = svd.matrixV();
-		Eigen::Matrix3d tmpR = V * U.transpose();
-		if (tmpR.determinant() < 0)
+	}
+
+	//Handle point rows, shared by the three axes
+	for (int i = 0; i < this->controlpoint_number.size(); i++)
+	{
+		const Eigen::Vector4i& tet = bary_vert_index[this->controlpoint_number[i].first];
+		for (int k = 0; k < 4; k++)
 		{
-			Eigen::VectorXd sigularDiagonal = svd.singularValues().diagonal();
-			double minSigularValue = sigularDiagonal.minCoeff();
-			int id = 0;
-			for (int m = 0; m < sigularDiagonal.size(); m++)
-			{
-				if (minSigularValue == sigularDiagonal[m])
-					id = m;
-			}
-			for (int m = 0; m < 3; m++)
-			{
-				U(m, id) = 0 - U(m, id);
-			}
-			tmpR = V * U.transpose();
+			tripletList.push_back(Tri(rowCounter, tet[k], barycentric[i][k]));
 		}
-		R[i] = tmpR;
+		rowCounter++;
 	}
-	//OMP_end
 }
 
-void ARAPDeform::yyj_ARAPDeform(std::string &handlefile, std::string outputFolder)
+// Local step in the precision of the positions, rotations and rest edges it is given
+// (the float one of mixedPrecision; doubles go through the kernels of ARAPRotationKernel.h)
+template <typename Scalar>
+static void fitRotations(const ARAPAdjacency& adjacency, const Eigen::Matrix<Scalar, 3, 1>* rest_edges,
+	std::vector<Eigen::Matrix<Scalar, 3, 3>>& R, const std::vector<Eigen::Matrix<Scalar, 3, 1>>& positions)
 {
-	std::ifstream iff(handlefile.c_str());
-	this->loadConstPoint(iff);
-	//for (int i = 0; i < mesh->n_vertices(); i++) {
-	for (int i = 0; i < barycentric.size(); i++) {
-		this->controlpoint_number.push_back(make_pair(i, Eigen::Vector3d(0, 0, 0))); // ¿ØÖÆµã(ÖØÐÄ×ø±ê)ÊýÄ¿
+	typedef Eigen::Matrix<Scalar, 3, 3> Matrix3;
+	typedef Eigen::Matrix<Scalar, 3, 1> Vector3;
+	const int n_vertices = adjacency.n_vertices();
+	// every vertex only reads the deformed positions and writes its own R[i]
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++)
+	{
+		Matrix3 edgeMatrixSum = Matrix3::Zero();
+		const Vector3& pi = positions[i];
+		for (int edgeCounter = adjacency.offsets[i]; edgeCounter < adjacency.offsets[i + 1]; edgeCounter++)
+		{
+			Vector3 deformedEdgeij = pi - positions[adjacency.neighbors[edgeCounter]];
+			//edgeMatrixSum += adjacency.weights[edgeCounter] * vec2mat(adjacency.rest_edges[edgeCounter], deformedEdgeij);
+			edgeMatrixSum.noalias() += rest_edges[edgeCounter] * deformedEdgeij.transpose();
+		}
+		R[i] = fitRotation(edgeMatrixSum);
 	}
-	TetrahedralMesh *deformed_mesh;
-	deformed_mesh = new TetrahedralMesh(*this->mesh);
-	std::vector<Eigen::Matrix3d> Rots;
+}
 
-	for (int i = 0; i < mesh->n_vertices(); i++)
+// Half-edge rows of the right-hand side, computed in Scalar and stored in double
+template <typename Scalar>
+static void assembleEdgeRhs(const ARAPAdjacency& adjacency, const Eigen::Matrix<Scalar, 3, 1>* rest_edges, const Scalar* weights,
+	const std::vector<Eigen::Matrix<Scalar, 3, 3>>& R, double* b)
+{
+	const int n_vertices = adjacency.n_vertices();
+	// the rows of vertex i start at 3 * offsets[i], so vertices are independent
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++)
 	{
-		Rots.push_back(Eigen::Matrix3d::Identity());
+		const Eigen::Matrix<Scalar, 3, 3>& Ri = R[i];
+		for (int edgeCounter = adjacency.offsets[i]; edgeCounter < adjacency.offsets[i + 1]; edgeCounter++)
+		{
+			int j = adjacency.neighbors[edgeCounter];
+			Eigen::Map<Eigen::Vector3d>(b + edgeCounter * 3) = ((Scalar(0.5) * weights[edgeCounter]) * ((Ri + R[j]) * rest_edges[edgeCounter])).template cast<double>();
+		}
 	}
+}
 
-	//this->global_step_pre(*deformed_mesh);
-	this->eigen_global_step_pre(*deformed_mesh);
+void ARAPDeform::local_step(std::vector<Eigen::Matrix3d>& R, const std::vector<Eigen::Vector3d>& positions) const
+{
+	fitRotations(rotationKernel, adjacency, positions, R);
+}
 
-	int columnNumber;
-	if (!hardConstrain)
+void ARAPDeform::local_step(ARAPState& state) const
+{
+	if (!mixedPrecision)
+	{
+		this->local_step(state.Rots, state.positions);
+		return;
+	}
+	const int n_vertices = (int)mesh->n_vertices();
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++) state.positionsF[i] = state.positions[i].cast<float>();
+	fitRotations(adjacency, rest_edges_f.data(), state.RotsF, state.positionsF);
+}
+
+void ARAPDeform::assemble_rhs(const std::vector<Eigen::Matrix3d>& R, const std::vector<Eigen::Vector3d>& constPoint, double* b) const
+{
+	// b is the job's preallocated right-hand side, x/y/z interleaved per row (see ARAPSolver);
+	// every row is overwritten, so no clearing is needed
+	assembleEdgeRhs(adjacency, adjacency.rest_edges.data(), adjacency.weights.data(), R, b);
+	this->assemble_control_rhs(constPoint, b);
+}
+
+void ARAPDeform::assemble_rhs(const ARAPState& state, const std::vector<Eigen::Vector3d>& constPoint, double* b) const
+{
+	if (!mixedPrecision)
+	{
+		this->assemble_rhs(state.Rots, constPoint, b);
+		return;
+	}
+	assembleEdgeRhs(adjacency, rest_edges_f.data(), weights_f.data(), state.RotsF, b);
+	this->assemble_control_rhs(constPoint, b);
+}
+
+void ARAPDeform::widen_rotations(ARAPState& state) const
+{
+	const int n_vertices = (int)mesh->n_vertices();
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n_vertices; i++) state.Rots[i] = state.RotsF[i].cast<double>();
+}
+
+void ARAPDeform::assemble_control_rhs(const std::vector<Eigen::Vector3d>& constPoint, double* b) const
+{
+	int rowCounter = adjacency.n_half_edges() * 3;
+	//handle point as hard constrain
+	for (int i = 0; i < this->controlpoint_number.size(); i++)
+	{
+		int constrolpointid = this->controlpoint_number[i].first;
+		Eigen::Map<Eigen::Vector3d>(b + rowCounter) = constPoint[constrolpointid];
+		rowCounter += 3;
+	}
+}
+
+bool ARAPDeform::prefactor()
+{
+	rest_edges_f.clear();
+	weights_f.clear();
+	if (mixedPrecision)
+	{
+		rest_edges_f.resize(adjacency.n_half_edges());
+		weights_f.resize(adjacency.n_half_edges());
+		for (int e = 0; e < adjacency.n_half_edges(); e++)
+		{
+			rest_edges_f[e] = adjacency.rest_edges[e].cast<float>();
+			weights_f[e] = (float)adjacency.weights[e];
+		}
+	}
+	if (matrixFree)
+	{
+		if (hardConstrain || !pinned.empty())
+		{
+			std::cerr << "Error: the matrix-free global step only supports soft constraints!" << std::endl;
+			return false;
+		}
+		ARAPPhaseTimer timer(profile, ARAP_PHASE_FACTORIZE);
+		std::vector<Eigen::Vector4i> tets(this->controlpoint_number.size());
+		std::vector<Eigen::Vector4d> barys(this->controlpoint_number.size());
+		for (int i = 0; i < this->controlpoint_number.size(); i++)
+		{
+			tets[i] = bary_vert_index[this->controlpoint_number[i].first];
+			barys[i] = barycentric[i];
+		}
+		if (!matrixFreeSolver.init(adjacency, tets, barys)) return false;
+		this->record_system();
+		return true;
+	}
+	ARAPPhaseTimer tripletTimer(profile, ARAP_PHASE_TRIPLETS);
+	int columnNumber, rowNumber, rhsCols, controlRows = 0;
+	if (separateAxes)
 	{
-		columnNumber = mesh->n_vertices() * 3;
+		// hard constraints are eliminated by the solver instead of extending the system
+		this->eigen_global_step_pre_axis();
+		columnNumber = mesh->n_vertices();
+		rowNumber = adjacency.n_half_edges() + this->controlpoint_number.size();
+		rhsCols = 3;
+		controlRows = this->controlpoint_number.size();
 	}
 	else
 	{
-		columnNumber = mesh->n_vertices() * 3 + this->controlpoint_number.size();
+		//this->global_step_pre(*this->mesh);
+		this->eigen_global_step_pre(*this->mesh);
+		if (!hardConstrain)
+		{
+			columnNumber = mesh->n_vertices() * 3;
+		}
+		else
+		{
+			columnNumber = mesh->n_vertices() * 3 + this->controlpoint_number.size();
+		}
+		rowNumber = (adjacency.n_half_edges() + this->controlpoint_number.size()) * 3;
+		rhsCols = 1;
 	}
-	int rowNumber = (edgeijs.size() + this->controlpoint_number.size()) * 3;
-	//this->vectorBSize = rowNumber + 1;
 
-	//this->yyj_CholeskyPre(this->matEngine, rowNumber, columnNumber, AcsrRowIndPtr[rowNumber], AcsrRowIndPtr, AcsrColPtr, AcsrValPtr);
-	std::cout << "Construct sparse A" << std::endl;
-	//Eigen::Map<Eigen::SparseMatrix<double, Eigen::RowMajor> > sparseA(rowNumber, columnNumber, AcsrRowIndPtr[rowNumber], AcsrRowIndPtr, AcsrColPtr, AcsrValPtr);
-	Eigen::SparseMatrix<double> sparseA(rowNumber, columnNumber);
-	sparseA.setFromTriplets(this->tripletList.begin(), this->tripletList.end());
-	std::cout << "Construct sparse AT" << std::endl;
-	Eigen::SparseMatrix<double> sparseAT = sparseA.transpose();
-	std::cout << "cholesky begin" << std::endl;
-	Eigen::SimplicialCholesky<Eigen::SparseMatrix<double>> chol(sparseAT*sparseA);
+	solver.fixedColumns.clear();
+	for (int v : pinned)
+	{
+		if (separateAxes) solver.fixedColumns.push_back(v);
+		else for (int a = 0; a < 3; a++) solver.fixedColumns.push_back(v * 3 + a);
+	}
 
-	// modify to sequence deformation.
-	// ÔÚload_data´¦¶¨Òåseq_constPoint
-	for (int seq_id = 0; seq_id < seq_constPoint.size(); seq_id++) {
-		constPoint = seq_constPoint[seq_id];
-		std::cout << "processing the " << seq_id << " deformation" << std::endl;
-		for (int iterationCounter = 0; iterationCounter < this->maxIterTime; iterationCounter++)
+	tripletTimer.stop();
+
+	// A, A^T*A and its factor are built once and kept for the whole sequence
+	ARAPPhaseTimer factorTimer(profile, ARAP_PHASE_FACTORIZE);
+	if (!solver.factorize(rowNumber, columnNumber, rhsCols, this->tripletList, controlRows, hardConstrain && separateAxes))
+	{
+		return false;
+	}
+	std::vector<Tri>().swap(this->tripletList);
+	factorTimer.stop();
+	this->record_system();
+	return true;
+}
+
+void ARAPDeform::record_frame(int seq_id, const ARAPFrameReport& report, double ms) const
+{
+	if (profile) profile->addFrame(seq_id, report.iterations, report.residual, report.converged, ms);
+}
+
+void ARAPDeform::record_system() const
+{
+	if (!profile) return;
+	profile->set("vertices", mesh->n_vertices());
+	profile->set("half_edges", adjacency.n_half_edges());
+	profile->set("controls", this->controlpoint_number.size());
+	profile->set("unknowns", matrixFree ? matrixFreeSolver.cols() : solver.cols());
+	profile->set("rows", matrixFree ? matrixFreeSolver.rows() : solver.rows());
+	profile->set("nnz_A", matrixFree ? 0 : solver.sparseA.nonZeros());
+	profile->set("nnz_AtA", matrixFree ? 0 : solver.normalMatrix.nonZeros());
+}
+
+int ARAPDeform::add_control(const Eigen::Vector4i& tet, const Eigen::Vector4d& bary)
+{
+	const int k = (int)this->controlpoint_number.size();
+	this->set_controls(std::vector<Eigen::Vector4i>(1, tet), std::vector<Eigen::Vector4d>(1, bary));
+	// set_controls numbers the rows it is given from 0
+	this->controlpoint_number.back().first = k;
+	for (int m = 0; m < 4; m++) control_index[tet[m]].back() = k;
+	if (!this->update_controls([&]() {
+		Eigen::SparseVector<double> row(mesh->n_vertices());
+		for (int m = 0; m < 4; m++) row.coeffRef(tet[m]) += bary[m];
+		return solver.addControlRow(row);
+	}))
+	{
+		return -1;
+	}
+	return k;
+}
+
+bool ARAPDeform::remove_control(int k)
+{
+	if (k < 0 || k >= this->controlpoint_number.size()) return false;
+	bary_vert_index.erase(bary_vert_index.begin() + k);
+	barycentric.erase(barycentric.begin() + k);
+	this->controlpoint_number.pop_back();
+	for (int i = 0; i < control_index.size(); i++)
+	{
+		control_index[i].clear();
+		control_weight[i].clear();
+	}
+	for (int i = 0; i < bary_vert_index.size(); i++)
+	{
+		for (int m = 0; m < 4; m++)
 		{
-			memset(this->vectorBPtr, 0, this->vectorBSize * sizeof(double));
-			int rowCounter = 0;  //used in assign value to Vertex Bs
+			control_index[bary_vert_index[i][m]].push_back(i);
+			control_weight[bary_vert_index[i][m]].push_back(barycentric[i][m]);
+		}
+	}
+	return this->update_controls([&]() { return solver.removeControlRow(k); });
+}
 
-			double lambdaDeformWeightCiCij = 0;
-			Eigen::Vector3d edgeij_weight;
-			Eigen::Matrix3d Ri, Rj;
-			Eigen::Vector3d RiRjEdgeij;
-			std::vector<Eigen::Vector3d> VecRiRjEdgeij;
-			/*VecRiRjEdgeij.resize(edgeijs.size(), Eigen::Vector3d::Zero());*/
+bool ARAPDeform::update_controls(const std::function<bool()>& lowRankEdit)
+{
+	// nothing factorized yet: the next prefactor() sees the new controls
+	if (!matrixFree && !solver.isFactorized()) return true;
+	if (matrixFree || !separateAxes || !pinned.empty() || solver.lowRankTerms() >= maxLowRankTerms)
+	{
+		// the matrix-free setup is cheap anyway; the interleaved system and pinned vertices have no low-rank path
+		return this->prefactor();
+	}
+	return lowRankEdit();
+}
 
-			for (int i = 0, edgeCounter = 0; i < mesh->n_vertices(); i++)
-			{
-				//iterate point j (i adjacent points)
-				VertexHandle vi(i);
-				//int edgeijIndex = this->edge_index[i];//first neighbor edge index
-				Ri = Rots[i];
+void ARAPDeform::init_state(ARAPState& state) const
+{
+	const int n_vertices = (int)mesh->n_vertices();
+	state.Rots.assign(n_vertices, Eigen::Matrix3d::Identity());
+	state.positions.resize(n_vertices);
+	for (int i = 0; i < n_vertices; i++)
+	{
+		state.positions[i] = OVtoE(mesh->vertex(VertexHandle(i)));
+	}
+	const int rows = matrixFree ? matrixFreeSolver.rows() : solver.rows();
+	const int cols = matrixFree ? matrixFreeSolver.cols() : solver.cols();
+	const int rhsCols = matrixFree ? matrixFreeSolver.rhsCols() : solver.rhsCols();
+	state.B.setZero(rows, rhsCols);
+	state.ATb.setZero(cols, rhsCols);
+	state.x.setZero(cols, rhsCols);
+	// the rest pose is the first guess of iterative backends; x then keeps the last solution
+	Eigen::Map<Eigen::VectorXd>(state.x.data(), n_vertices * 3) = Eigen::Map<const Eigen::VectorXd>(state.positions[0].data(), n_vertices * 3);
+}
 
-				//iterate point j (i adjacent points)
-				for (OpenVolumeMesh::VertexVertexIter vj = deformed_mesh->vv_iter(vi); vj; vj++)
-				{
-					int j = vj->idx();
-					//lambdaDeformWeightCiCij = this->edge_weights[edgeijIndex];
-					lambdaDeformWeightCiCij = this->edge_weights[edgeCounter];
-					edgeij_weight = this->edge_weights[edgeCounter] * this->edgeijs[edgeCounter];//edgejk = pj -pk
-																								 //assert(edgeij_weight == edgeij_weight);
-					Rj = Rots[j];
-					RiRjEdgeij = 0.5 * (Ri + Rj) * edgeij_weight;
-					VecRiRjEdgeij.push_back(RiRjEdgeij);
-					//VecRiRjEdgeij[_edgetick] = RiRjEdgeij;
-					//_edgetick++;
-					//Point parameter
-					//this->vectorBPtr[rowCounter + 0] = lambdaDeformWeightCiCij * (this->constPoint[j][0] * this->isConst_i[j] - this->constPoint[i][0] * this->isConst_i[i]);
-					//this->vectorBPtr[rowCounter + 1] = lambdaDeformWeightCiCij * (this->constPoint[j][1] * this->isConst_i[j] - this->constPoint[i][1] * this->isConst_i[i]);
-					//this->vectorBPtr[rowCounter + 2] = lambdaDeformWeightCiCij * (this->constPoint[j][2] * this->isConst_i[j] - this->constPoint[i][2] * this->isConst_i[i]);
-					edgeCounter++;
-					rowCounter += 3;
-				}
-			}
+void ARAPDeform::set_positions(ARAPState& state, const std::vector<Eigen::Vector3d>& positions) const
+{
+	const int n_vertices = (int)mesh->n_vertices();
+	state.positions = positions;
+	Eigen::Map<Eigen::VectorXd>(state.x.data(), n_vertices * 3) = Eigen::Map<const Eigen::VectorXd>(state.positions[0].data(), n_vertices * 3);
+	this->local_step(state.Rots, state.positions);
+}
 
-			for (int j = 0; j < half_edge_num; j++)
-			{
-				this->vectorBPtr[j * 3 + 0] += VecRiRjEdgeij[j][0];
-				this->vectorBPtr[j * 3 + 1] += VecRiRjEdgeij[j][1];
-				this->vectorBPtr[j * 3 + 2] += VecRiRjEdgeij[j][2];
-			}
+double ARAPDeform::energy(const std::vector<Eigen::Matrix3d>& R, const std::vector<Eigen::Vector3d>& p, const std::vector<Eigen::Vector3d>& frameConstPoint) const
+{
+	// squared residual of the global least-squares system at the given positions and rotations
+	const int n_vertices = (int)mesh->n_vertices();
+	double E = 0;
+#pragma omp parallel for schedule(static) reduction(+:E)
+	for (int i = 0; i < n_vertices; i++)
+	{
+		for (int edgeCounter = adjacency.offsets[i]; edgeCounter < adjacency.offsets[i + 1]; edgeCounter++)
+		{
+			int j = adjacency.neighbors[edgeCounter];
+			double w = adjacency.weights[edgeCounter];
+			E += (w * ((p[i] - p[j]) - 0.5 * (R[i] + R[j]) * adjacency.rest_edges[edgeCounter])).squaredNorm();
+		}
+	}
+	for (int i = 0; i < this->controlpoint_number.size(); i++)
+	{
+		const Eigen::Vector4i& tet = bary_vert_index[this->controlpoint_number[i].first];
+		Eigen::Vector3d c = Eigen::Vector3d::Zero();
+		for (int k = 0; k < 4; k++) c += barycentric[i][k] * p[tet[k]];
+		E += (c - frameConstPoint[this->controlpoint_number[i].first]).squaredNorm();
+	}
+	return E;
+}
 
-			//handle point as hard constrain						
-			for (int i = 0; i < this->controlpoint_number.size(); i++)
-			{
-				int constrolpointid = this->controlpoint_number[i].first;
-				this->vectorBPtr[rowCounter + 0] = constPoint[constrolpointid][0];
-				this->vectorBPtr[rowCounter + 1] = constPoint[constrolpointid][1];
-				this->vectorBPtr[rowCounter + 2] = constPoint[constrolpointid][2];
-				rowCounter += 3;
-			}
+// largest distance between corresponding vertices of two interleaved xyz arrays
+static double maxVertexMove(const double* a, const double* b, int n_vertices)
+{
+	double d = 0;
+	for (int i = 0; i < n_vertices; i++)
+	{
+		d = std::max(d, (Eigen::Map<const Eigen::Vector3d>(a + i * 3) - Eigen::Map<const Eigen::Vector3d>(b + i * 3)).squaredNorm());
+	}
+	return std::sqrt(d);
+}
 
-			//È±ÉÙÒ»¸öº¯ÊýÀûÓÃÕâÐ©±äÁ¿½øÐÐÇó½â
-			long t1 = clock();
-			//this->yyj_LeastSquareSolve(this->matEngine, rowNumber, columnNumber, AcsrRowIndPtr[rowNumber], AcsrRowIndPtr, AcsrColPtr, AcsrValPtr, vectorBPtr, resultX);
-			//this->yyj_CholeskySolve(this->matEngine, rowNumber, columnNumber, vectorBPtr, resultX);
-			vectorB.resize(this->vectorBSize);
-			for (int i = 0; i < this->vectorBSize; i++)
-			{
-				vectorB[i] = vectorBPtr[i];
-			}
-			Eigen::VectorXd x = chol.solve(sparseAT*vectorB);
-			std::cout << "Global Time:" << clock() - t1 << std::endl;
+ARAPFrameReport ARAPDeform::deform_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPState& state) const
+{
+	if (!warmStart)
+	{
+		this->init_state(state);
+	}
+	return this->iterate_frame(frameConstPoint, state, this->maxIterTime);
+}
+
+ARAPFrameReport ARAPDeform::iterate_frame(const std::vector<Eigen::Vector3d>& frameConstPoint, ARAPState& state, int maxIter) const
+{
+	const int n_vertices = (int)mesh->n_vertices();
+	ARAPFrameReport report;
+	const bool anderson = andersonWindow > 0;
+	// controls may have been added or removed since the state was created
+	const int rows = matrixFree ? matrixFreeSolver.rows() : solver.rows();
+	if (state.B.rows() != rows) state.B.setZero(rows, state.B.cols());
+	double lastEnergy = 0;
+	if (convergence == ARAP_ENERGY)
+	{
+		lastEnergy = this->energy(state.Rots, state.positions, frameConstPoint);
+	}
+	if (mixedPrecision)
+	{
+		state.RotsF.resize(n_vertices);
+		state.positionsF.resize(n_vertices);
+		for (int i = 0; i < n_vertices; i++) state.RotsF[i] = state.Rots[i].cast<float>();
+	}
+	int cgIterations = 0;
+	for (int iterationCounter = 0; iterationCounter < maxIter; iterationCounter++)
+	{
+		ARAPPhaseTimer rhsTimer(profile, ARAP_PHASE_RHS);
+		this->assemble_rhs(state, frameConstPoint, state.B.data());
+		rhsTimer.stop();
+
+		ARAPPhaseTimer solveTimer(profile, ARAP_PHASE_SOLVE);
+		if (matrixFree) cgIterations += matrixFreeSolver.solve(state.B, state.ATb, state.x);
+		else solver.solve(state.B, state.ATb, state.x);
+		solveTimer.stop();
 
-			for (int i = 0; i < mesh->n_vertices(); i++)
+		// the first 3|V| entries of x are the interleaved vertex positions in both solver layouts
+		Eigen::Map<Eigen::VectorXd> p(state.positions[0].data(), n_vertices * 3);
+		Eigen::Map<const Eigen::VectorXd> g(state.x.data(), n_vertices * 3);
+		// fixed-point residual: how far one plain local/global step moves the current positions
+		double maxDisplacement = maxVertexMove(g.data(), p.data(), n_vertices);
+		report.iterations = iterationCounter + 1;
+		if (anderson)
+		{
+			// accelerate the fixed-point map positions -> local step -> global step
+			if (iterationCounter == 0) state.anderson.init(n_vertices * 3, andersonWindow, p);
+			if (state.anderson.accelerated() && (g - p).norm() > state.anderson.residualNorm())
 			{
-				VertexHandle vi(i);
-				//Tet_vec3d tmp_vertex(this->resultX[i * 3 + 0], this->resultX[i * 3 + 1], this->resultX[i * 3 + 2]);
-				Tet_vec3d tmp_vertex(x[i * 3 + 0], x[i * 3 + 1], x[i * 3 + 2]);
-				deformed_mesh->set_vertex(vi, tmp_vertex);
+				// safeguard: the accelerated step increased the residual, fall back to the plain
+				// step from the previous iterate and restart the history there
+				report.rejected++;
+				p = state.anderson.lastG();
+				state.anderson.reset(p);
+				ARAPPhaseTimer localTimer(profile, ARAP_PHASE_LOCAL);
+				this->local_step(state);
+				continue;
 			}
+			p = state.anderson.compute(g);
+		}
+		else
+		{
+			p = g;
+		}
+
+		ARAPPhaseTimer localTimer(profile, ARAP_PHASE_LOCAL);
+		this->local_step(state);
+		localTimer.stop();
+
+		if (convergence == ARAP_ENERGY)
+		{
+			if (mixedPrecision) this->widen_rotations(state);
+			// relative energy change of this iteration
+			double E = this->energy(state.Rots, state.positions, frameConstPoint);
+			report.residual = std::abs(lastEnergy - E) / std::max(E, 1e-300);
+			report.energy = E;
+			lastEnergy = E;
+		}
+		else
+		{
+			// relative to the rest bounding box diagonal
+			report.residual = maxDisplacement / bbox_diagonal;
+		}
+		if (report.residual <= tolerance)
+		{
+			report.converged = true;
+			break;
+		}
+	} // end of iteration
+	if (mixedPrecision)
+	{
+		this->widen_rotations(state);
+	}
+	if (profile)
+	{
+		profile->increment("iterations", report.iterations);
+		profile->increment("rejected_steps", report.rejected);
+		if (matrixFree) profile->increment("cg_iterations", cgIterations);
+	}
+	return report;
+}
 
-			long t2 = clock();
-			local_step(Rots, *deformed_mesh);
-			std::cout << "Local Time:" << clock() - t2 << std::endl;
-		} // end of iteration
+bool ARAPWeightReport::ok() const
+{
+	if (!degenerateCells.empty()) return false;
+	for (const Edge& e : edges)
+	{
+		if (strcmp(e.reason, "no valid tet") == 0 || strcmp(e.reason, "non-finite") == 0) return false;
+	}
+	return true;
+}
+
+std::string ARAPWeightReport::summary() const
+{
+	std::map<std::string, int> reasons;
+	for (const Edge& e : edges) reasons[e.reason]++;
+	std::ostringstream oss;
+	oss << "weights: " << degenerateCells.size() << " of " << n_tets << " tets degenerate";
+	for (const auto& r : reasons) oss << ", " << r.second << " edges " << r.first;
+	oss << ", range [" << minWeight << ", " << maxWeight << "]";
+	return oss.str();
+}
+
+// JSON has no inf/NaN
+bool ARAPWeightReport::write(const std::string& filename) const
+{
+	std::ofstream off(filename.c_str());
+	off << "{\n";
+	off << "  \"ok\": " << (ok() ? "true" : "false") << ",\n";
+	off << "  \"vertices\": " << n_vertices << ",\n";
+	off << "  \"tets\": " << n_tets << ",\n";
+	off << "  \"edges\": " << n_edges << ",\n";
+	off << "  \"min_weight\": " << jsonNumber(minWeight) << ",\n";
+	off << "  \"max_weight\": " << jsonNumber(maxWeight) << ",\n";
+	off << "  \"degenerate_tets\": [";
+	for (int k = 0; k < degenerateCells.size(); k++)
+	{
+		const Cell& c = degenerateCells[k];
+		off << (k ? ",\n    " : "\n    ") << "{\"tet\": " << c.tet << ", \"vertices\": [" << c.vertices[0] << ", " << c.vertices[1]
+			<< ", " << c.vertices[2] << ", " << c.vertices[3] << "], \"quality\": " << jsonNumber(c.quality) << "}";
+	}
+	off << (degenerateCells.empty() ? "],\n" : "\n  ],\n");
+	off << "  \"modified_edges\": [";
+	for (int k = 0; k < edges.size(); k++)
+	{
+		const Edge& e = edges[k];
+		off << (k ? ",\n    " : "\n    ") << "{\"i\": " << e.i << ", \"j\": " << e.j << ", \"raw\": " << jsonNumber(e.raw)
+			<< ", \"weight\": " << jsonNumber(e.weight) << ", \"reason\": \"" << e.reason << "\"}";
+	}
+	off << (edges.empty() ? "]\n" : "\n  ]\n");
+	off << "}\n";
+	if (!off.good())
+	{
+		std::cerr << "Error: could not write weight report " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
 
-		string file_id = std::to_string(seq_id);
-		while (file_id.size() < 4) file_id = "0" + file_id;
-		string outputName = outputFolder + "/arap_result_" + file_id +"_.ovm";
-		myWriteFile(outputName, *deformed_mesh);
+std::string arapResultName(const std::string& outputFolder, int seq_id)
+{
+	std::string file_id = std::to_string(seq_id);
+	while (file_id.size() < 4) file_id = "0" + file_id;
+	return outputFolder + "/arap_result_" + file_id + "_.ovm";
+}
+
+std::string arapFrameSummary(int seq_id, const ARAPFrameReport& report)
+{
+	std::ostringstream oss;
+	oss << "frame " << seq_id << ": " << report.iterations << " iterations, residual " << report.residual
+		<< (report.converged ? " (converged)" : " (not converged)");
+	if (report.rejected > 0) oss << ", " << report.rejected << " accelerated steps rejected";
+	return oss.str();
+}
+
+bool ARAPDeform::yyj_ARAPDeform(std::string &handlefile, std::string outputFolder)
+{
+	// text or binary; binary frames are streamed from the mapped file one at a time
+	ARAPHandleFile handles;
+	ARAPPhaseTimer loadTimer(profile, ARAP_PHASE_LOAD);
+	if (!handles.open(handlefile) || !handles.checkVertices((int)mesh->n_vertices()))
+	{
+		return false;
+	}
+	loadTimer.stop();
+	this->set_controls(handles.bary_vert_index, handles.barycentric);
+
+	// A, A^T*A and its factor are built once and kept for the whole sequence
+	if (!this->prefactor())
+	{
+		return false;
+	}
+	ARAPState state;
+	this->init_state(state);
+
+	// modify to sequence deformation.
+	ARAPFrameWriter writer(*this->mesh, outputFolder, outputFormat, profile);
+	std::vector<Eigen::Vector3d> frameBuffer;
+	for (int seq_id = 0; seq_id < handles.frames(); seq_id++) {
+		std::cout << "processing the " << seq_id << " deformation" << std::endl;
+		auto t0 = std::chrono::steady_clock::now();
+		ARAPFrameReport report = this->deform_frame(handles.frame(seq_id, frameBuffer), state);
+		this->record_frame(seq_id, report, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+		std::cout << arapFrameSummary(seq_id, report) << std::endl;
+		writer.write(seq_id, state.positions);
 		//this->matEngine.EvalString("close");
 	}
+	return writer.finish();
 	//this->matEngine.EvalString("exit");
 }
 